@@ -0,0 +1,139 @@
+#include <strings.h>
+
+#include "config.h"
+#include "common.h"
+#include "burst.h"
+#include "workload.h"
+
+/* Take the decision from the job bursts in workload. A burst longer
+   than the slice goes on in next slice */
+static void burst_replay(struct proc * proc, const simtime_t slice){
+
+  if(proc->wl_left == 0){
+    proc->timer[T_BURST] = 0;
+    proc->action = ACT_TERM;
+    return;
+  }
+
+  const struct workload_burst * burst = workload_burst(proc->wl_pos);
+  const simtime_t left = burst->cpu - proc->wl_used;
+  if(left > slice){
+    proc->action = ACT_EXEC;
+    proc->timer[T_BURST] = slice;
+    proc->wl_used += slice;
+    return;
+  }
+
+  proc->timer[T_BURST] = left;
+  proc->wl_used = 0;
+  proc->wl_pos += sizeof(struct workload_burst);
+  if(--proc->wl_left == 0){
+    proc->action = ACT_TERM;
+  }else{
+    proc->action = ACT_INT;
+    proc->timer[T_IOEND] = burst->io;
+  }
+}
+
+void burst_decide(struct proc * proc, const simtime_t slice){
+
+  if(workload_count() > 0){
+    burst_replay(proc, slice);
+    return;
+  }
+
+  /* terminate ?*/
+  if(rng_below(&proc->rng[RNG_TERM], 100) < CHANCE_TO_TERMINATE){
+
+    /* use part of allocated slice */
+    proc->timer[T_BURST] = rng_below64(&proc->rng[RNG_TERM], slice);
+    proc->action = ACT_TERM;
+
+  }else{
+
+    /* interrupt for IO ?*/
+    if(rng_below(&proc->rng[RNG_INT], 100) < simulator_obj->cfg.int_prob[proc->bound]){
+
+      proc->action = ACT_INT;
+
+      /* use part of allocated slice */
+      proc->timer[T_BURST] = rng_below64(&proc->rng[RNG_INT], slice);
+
+      /* IO duration */
+      proc->timer[T_IOEND]  = rng_below(&proc->rng[RNG_IO], 6) * NS_PER_SEC;     //[0, 5] s
+      proc->timer[T_IOEND] += rng_below(&proc->rng[RNG_IO], 1001) * NS_PER_USEC; //[0, 1000] us
+
+    }else{
+      /* execute */
+      proc->action = ACT_EXEC;
+      /* process will execute for whole timeslice */
+      proc->timer[T_BURST] = slice;
+    }
+  }
+}
+
+int burst_loop(const int my_id, const pid_t pid){
+  struct msgbuf buf;
+  /* last decision is kept here, because a pooled control block
+     is reused by oss, as soon as we reply that we terminate */
+  enum proc_action action = ACT_EXEC;
+
+  /* get our control block. Its action is left alone, since oss
+     may keep a decision there, when it restores a checkpoint */
+  struct proc * proc = &simulator_obj->procs[my_id];
+
+  while(action != ACT_TERM){ //while we haven't decided to terminate
+
+    /* receive message from master */
+    buf.mtype = pid;
+    buf.id = my_id;
+    if(msg_recv(&buf)  == -1){
+      return -1;
+    }
+
+    if(buf.slice == 0){ //if time slice is 0
+      break;  //stop
+    }
+
+    burst_decide(proc, buf.slice);
+    action = proc->action;
+
+    bzero(&buf, sizeof(buf));
+
+    /* send message to oss, to inform our burst is over */
+    buf.mtype = TYPE_BURSTED;
+    /* save our ID in message */
+    buf.id = my_id;
+    if(msg_send(&buf) == -1){
+      return -1;
+    }
+  }
+
+  return (action == ACT_TERM) ? 1 : 0;
+}
+
+int worker_loop(const int my_id, const pid_t wpid){
+  struct msgbuf buf;
+
+  while(1){
+
+    /* wait for oss to give us a process */
+    buf.mtype = wpid;
+    buf.id = my_id;
+    if(msg_recv(&buf) == -1){
+      return -1;
+    }
+
+    if(buf.slice == 0){ //pool is stopped
+      break;
+    }
+
+    /* process runs until it terminates, then its slot is free again */
+    const int rv = burst_loop(my_id, simulator_obj->procs[my_id].pid);
+    if(rv != 1){
+      return rv;  //stopped in middle of process
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef BURST_H
+#define BURST_H
+
+#include "common.h"
+
+/* decide what process does with the slice - terminate, interrupt or execute.
+   With a workload open, it is replayed from the bursts of the job */
+void burst_decide(struct proc * proc, const simtime_t slice);
+
+/* Run the user side of a process - receive slices from oss and reply with
+   bursts, until process terminates. pid is the message type we receive.
+   Returns 1 if process terminated, 0 if it was stopped, -1 on error */
+int burst_loop(const int id, const pid_t pid);
+
+/* Run processes of control block id, one after another. Each starts with
+   a message of type wpid, and a zero slice stops the worker */
+int worker_loop(const int id, const pid_t wpid);
+
+#endif
@@ -1,33 +1,76 @@
-#include <strings.h>
-#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "common.h"
 #include "bv.h"
 
-static unsigned char bitvector[(PROC_LIMIT/8) + 1];
+#define BV_WORD_BITS 64
+
+static uint64_t * bitvector = NULL;
+static unsigned int bv_bits = 0, bv_words = 0;
+/* lowest word, which may have a free bit */
+static unsigned int bv_hint = 0;
+
+int bv_init(const unsigned int n){
+  bv_bits  = n;
+  bv_words = (n + BV_WORD_BITS - 1) / BV_WORD_BITS;
+  bv_hint  = 0;
 
-void bv_init(){
   /* turn all bits to 0 */
-  bzero(bitvector, sizeof(bitvector));
+  bitvector = (uint64_t*) calloc(bv_words, sizeof(uint64_t));
+  if(bitvector == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  /* raise the unused bits in last word, so they are never free */
+  if(n % BV_WORD_BITS){
+    bitvector[bv_words - 1] = ~0ULL << (n % BV_WORD_BITS);
+  }
+  return 0;
+}
+
+void bv_free(){
+  free(bitvector);
+  bitvector = NULL;
+  bv_bits = bv_words = 0;
 }
 
 int bit_test(const int n){
-  return (bitvector[n / 8] & (1 << (n % 8)));
+  return (bitvector[n / BV_WORD_BITS] >> (n % BV_WORD_BITS)) & 1;
 }
 
 int bv_index(){
-  int i;
-  for(i = 0; i < PROC_LIMIT; i++){
-    if(bit_test(i) == 0){
-      bv_on(i);
-      return i;
+  unsigned int i;
+  for(i = bv_hint; i < bv_words; i++){
+    if(bitvector[i] != ~0ULL){
+      /* lowest zero bit is the lowest one in the inverted word */
+      const int n = (i * BV_WORD_BITS) + __builtin_ctzll(~bitvector[i]);
+      bv_hint = i;
+      bv_on(n);
+      return n;
     }
   }
+  bv_hint = bv_words;
   return -1;
 }
 
+unsigned int bv_count_free(){
+  unsigned int i, used = 0;
+  for(i = 0; i < bv_words; i++){
+    used += __builtin_popcountll(bitvector[i]);
+  }
+  /* unused bits in last word are always raised */
+  return (bv_words * BV_WORD_BITS) - used;
+}
+
 void bv_on(const int n){
-  bitvector[n / 8] ^= (1 << (n % 8));
+  bitvector[n / BV_WORD_BITS] |= (1ULL << (n % BV_WORD_BITS));
 }
 
 void bv_off(const int n){
-  bitvector[n / 8] ^= (1 << (n % 8));
+  bitvector[n / BV_WORD_BITS] &= ~(1ULL << (n % BV_WORD_BITS));
+  if((n / BV_WORD_BITS) < bv_hint){
+    bv_hint = n / BV_WORD_BITS;
+  }
 }
@@ -1,3 +1,6 @@
+#ifndef BV_H
+#define BV_H
+
 /*check if bit is 1 */
 int  bit_test(const int);
 
@@ -10,5 +13,13 @@ void bv_off(const int);
 /* return index of a free bit */
 int bv_index();
 
-/* initialize the bit vector */
-void bv_init();
+/* return number of free bits */
+unsigned int bv_count_free();
+
+/* initialize the bit vector with n bits */
+int bv_init(const unsigned int n);
+
+/* release the bit vector */
+void bv_free();
+
+#endif
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+#include "cfs.h"
+
+/* Pairing heap links - rq_child is first child, rq_next is next sibling
+   and rq_prev is left sibling, or parent for the first child */
+#define P(id) (&simulator_obj->procs[id])
+
+static int cfs_root = -1;
+static unsigned int cfs_len = 0;
+static uint64_t cfs_weight_sum = 0;  /* weight of processes in heap */
+static simtime_t min_vruntime = 0;   /* only grows */
+
+static unsigned int cfs_weight(const struct proc * proc){
+  return cfs_weights[proc->bound];
+}
+
+void cfs_init(){
+  cfs_root = -1;
+  cfs_len = 0;
+  cfs_weight_sum = 0;
+  min_vruntime = 0;
+}
+
+/* order by virtual runtime, then by queue time */
+static int cfs_less(const int a, const int b){
+  if(P(a)->vruntime != P(b)->vruntime){
+    return P(a)->vruntime < P(b)->vruntime;
+  }
+  if(P(a)->rq_added != P(b)->rq_added){
+    return P(a)->rq_added < P(b)->rq_added;
+  }
+  return a < b;
+}
+
+/* join two heaps, the later root becomes first child of the earlier */
+static int cfs_meld(int a, int b){
+  if(a == -1){
+    return b;
+  }else if(b == -1){
+    return a;
+  }
+
+  if(cfs_less(b, a)){
+    const int t = a;
+    a = b;
+    b = t;
+  }
+
+  P(b)->rq_prev = a;
+  P(b)->rq_next = P(a)->rq_child;
+  if(P(a)->rq_child != -1){
+    P(P(a)->rq_child)->rq_prev = b;
+  }
+  P(a)->rq_child = b;
+
+  return a;
+}
+
+/* join a list of siblings in two passes - pairs left to right,
+   then the pairs right to left */
+static int cfs_merge_pairs(int first){
+  int pairs = -1;
+
+  while(first != -1){
+    const int a = first;
+    const int b = P(a)->rq_next;
+    first = (b == -1) ? -1 : P(b)->rq_next;
+
+    P(a)->rq_prev = P(a)->rq_next = -1;
+    if(b != -1){
+      P(b)->rq_prev = P(b)->rq_next = -1;
+    }
+
+    /* pairs are listed in reverse, through rq_next */
+    const int m = cfs_meld(a, b);
+    P(m)->rq_next = pairs;
+    pairs = m;
+  }
+
+  int root = -1;
+  while(pairs != -1){
+    const int next = P(pairs)->rq_next;
+    P(pairs)->rq_next = -1;
+    root = cfs_meld(root, pairs);
+    pairs = next;
+  }
+  return root;
+}
+
+void cfs_push(struct proc * proc){
+  /* new and woken processes start near the queue minimum, with a small
+     credit, so they can't run for all the time they didn't */
+  const simtime_t credit = simulator_obj->cfg.slice_ns / 2;
+  if((min_vruntime > credit) && (proc->vruntime < (min_vruntime - credit))){
+    proc->vruntime = min_vruntime - credit;
+  }
+
+  proc->rq_level = 0;
+  proc->rq_prev = proc->rq_next = proc->rq_child = -1;
+  cfs_root = cfs_meld(cfs_root, proc->id);
+
+  cfs_len++;
+  cfs_weight_sum += cfs_weight(proc);
+}
+
+static void cfs_unlink(struct proc * proc){
+  proc->rq_level = -1;
+  proc->rq_prev = proc->rq_next = proc->rq_child = -1;
+  cfs_len--;
+  cfs_weight_sum -= cfs_weight(proc);
+}
+
+int cfs_top(){
+  return cfs_root;
+}
+
+int cfs_save(FILE * fp){
+  if( (fwrite(&cfs_root, sizeof(cfs_root), 1, fp) != 1) ||
+      (fwrite(&cfs_len, sizeof(cfs_len), 1, fp) != 1) ||
+      (fwrite(&cfs_weight_sum, sizeof(cfs_weight_sum), 1, fp) != 1) ||
+      (fwrite(&min_vruntime, sizeof(min_vruntime), 1, fp) != 1)){
+    return -1;
+  }
+  return 0;
+}
+
+int cfs_load(FILE * fp){
+  if( (fread(&cfs_root, sizeof(cfs_root), 1, fp) != 1) ||
+      (fread(&cfs_len, sizeof(cfs_len), 1, fp) != 1) ||
+      (fread(&cfs_weight_sum, sizeof(cfs_weight_sum), 1, fp) != 1) ||
+      (fread(&min_vruntime, sizeof(min_vruntime), 1, fp) != 1)){
+    return -1;
+  }
+  return 0;
+}
+
+unsigned int cfs_length(){
+  return cfs_len;
+}
+
+static int cfs_pop(){
+  const int id = cfs_root;
+  if(id == -1){
+    return -1;
+  }
+  struct proc * proc = P(id);
+
+  cfs_root = cfs_merge_pairs(proc->rq_child);
+  if(proc->vruntime > min_vruntime){
+    min_vruntime = proc->vruntime;
+  }
+  cfs_unlink(proc);
+
+  return id;
+}
+
+void cfs_remove(struct proc * proc){
+  if(proc->id == cfs_root){
+    cfs_pop();
+    return;
+  }
+
+  /* cut it from its parent or left sibling */
+  const int prev = proc->rq_prev;
+  if(P(prev)->rq_child == proc->id){
+    P(prev)->rq_child = proc->rq_next;
+  }else{
+    P(prev)->rq_next = proc->rq_next;
+  }
+  if(proc->rq_next != -1){
+    P(proc->rq_next)->rq_prev = prev;
+  }
+
+  /* and put its children back */
+  cfs_root = cfs_meld(cfs_root, cfs_merge_pairs(proc->rq_child));
+  cfs_unlink(proc);
+}
+
+/* Target latency (-q) is shared by processes waiting for each core, by weight,
+   but no slice is shorter than the minimum granularity */
+simtime_t cfs_slice(const struct proc * proc){
+  const simtime_t latency = simulator_obj->cfg.slice_ns;
+  const simtime_t min_slice = latency / CFS_MIN_GRAN;
+  const uint64_t weight = cfs_weight(proc);
+  const uint64_t total = weight + (cfs_weight_sum / simulator_obj->cfg.cores);
+
+  simtime_t slice = (latency * weight) / total;
+  if(slice < min_slice){
+    slice = min_slice;
+  }
+  return (slice > 0) ? slice : 1;
+}
+
+void cfs_account(struct proc * proc, const simtime_t burst){
+  proc->vruntime += (burst * CFS_WEIGHT_NICE0) / cfs_weight(proc);
+}
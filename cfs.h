@@ -0,0 +1,28 @@
+#ifndef CFS_H
+#define CFS_H
+
+#include <stdio.h>
+#include "common.h"
+
+/* Fair ready queue - runnable processes ordered by weighted virtual runtime.
+   Processes are kept in a pairing heap, linked through their control blocks */
+
+void cfs_init();
+
+void cfs_push(struct proc * proc);
+/* process with smallest virtual runtime, -1 if empty */
+int  cfs_top();
+void cfs_remove(struct proc * proc);
+/* processes in heap */
+unsigned int cfs_length();
+
+/* write and read heap state, links are in the control blocks */
+int cfs_save(FILE * fp);
+int cfs_load(FILE * fp);
+
+/* slice of a process that is dispatched */
+simtime_t cfs_slice(const struct proc * proc);
+/* charge process for its burst */
+void cfs_account(struct proc * proc, const simtime_t burst);
+
+#endif
@@ -1,32 +1,124 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/msg.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
 #include <limits.h>
 #include <unistd.h>
 #include <strings.h>
+#include <string.h>
+#include <ctype.h>
 #include <time.h>
 
 #include "config.h"
 #include "common.h"
+#include "ring.h"
+#include "log.h"
+
+/* message size, without the type */
+#define MSG_SIZE (sizeof(struct msgbuf) - sizeof(long))
 
 static int shmid = -1, msgid = -1;
 static char simulator_file[PATH_MAX];
+static unsigned int simulator_id = 0;  /* instance, so many oss can run */
 
-int is_signalled = 0;
 struct simulator_object * simulator_obj = NULL;
 char perror_buf[100];
 
+/* ring channels are after the control blocks, aligned to cache line */
+static size_t chan_offset(const unsigned int n){
+  const size_t off = sizeof(struct simulator_object) + (n * sizeof(struct proc));
+  return (off + RING_ALIGN - 1) & ~((size_t)RING_ALIGN - 1);
+}
+
+static struct msg_chan * sim_chan(const int id){
+  char * base = (char*) simulator_obj;
+  return &((struct msg_chan*) (base + chan_offset(simulator_obj->cfg.proc_limit)))[id];
+}
+
+void simulator_instance(const unsigned int id){
+  simulator_id = id;
+}
+
+/* parse a positive number option, up to UINT_MAX */
+int opt_number(const char * arg, const char * what, unsigned int * value){
+  char * end;
+
+  errno = 0;
+  const unsigned long n = strtoul(arg, &end, 10);
+  if(!isdigit((unsigned char) arg[0]) || (*end != '\0') || (errno == ERANGE) ||
+     (n == 0) || (n > UINT_MAX)){
+    fprintf(stderr, "Error: Invalid %s\n", what);
+    return -1;
+  }
+  *value = n;
+  return 0;
+}
+
+const char * simulator_path(){
+  /* create the license filename, using user ID and instance */
+  if(simulator_id == 0){
+    snprintf(simulator_file, PATH_MAX, "/tmp/oss_simulator.%u", getuid());
+  }else{
+    snprintf(simulator_file, PATH_MAX, "/tmp/oss_simulator.%u.%u", getuid(), simulator_id);
+  }
+  return simulator_file;
+}
+
+int shm_remove_stale(const key_t key){
+  struct shmid_ds ds;
+
+  const int id = shmget(key, 0, 0);
+  if(id == -1){
+    return 0; /* nothing left over */
+  }
+
+  if(shmctl(id, IPC_STAT, &ds) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+
+  /* creator is alive, so its not stale */
+  if((kill(ds.shm_cpid, 0) == 0) || (errno == EPERM)){
+    fprintf(stderr, "%sInstance %u is used by oss with PID %d\n", perror_buf, simulator_id, ds.shm_cpid);
+    return -1;
+  }
+
+  log_msg(LOG_WARN, "OSS: Removing shared memory left by PID %d\n", ds.shm_cpid);
+  if(shmctl(id, IPC_RMID, NULL) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+  return 1;
+}
+
+/* Remove message queue of a crashed oss. Called only after its
+   shared memory was found stale, so nobody is using the queue */
+static int msg_remove_stale(const key_t key){
+  const int id = msgget(key, 0);
+  if(id == -1){
+    return 0;
+  }
+
+  log_msg(LOG_WARN, "OSS: Removing message queue left over\n");
+  if(msgctl(id, IPC_RMID, NULL) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+  return 1;
+}
+
 int create_simulator(const int num_licenses){
 
-  /* create the license filename, using user ID*/
-  snprintf(simulator_file, PATH_MAX, "/tmp/oss_simulator.%u", getuid());
+  simulator_path();
 
   if(num_licenses){
-    printf("OSS: Simulator file is %s\n", simulator_file);
+    log_msg(LOG_INFO, "OSS: Simulator file is %s\n", simulator_file);
 
     /* create the license file */
     int fd = creat(simulator_file, 0700);
@@ -44,7 +136,15 @@ int create_simulator(const int num_licenses){
     return -1;
   }
 
-  shmid = shmget(license_key, sizeof(struct simulator_object), (num_licenses) ? IPC_CREAT | IPC_EXCL | S_IRWXU : 0);
+  /* a crashed run leaves its segment and queue behind */
+  if((num_licenses) && (shm_remove_stale(license_key) < 0)){
+    return -1;
+  }
+
+  /* users attach with size 0, and read the real size from header */
+  const size_t shm_size = (num_licenses) ? chan_offset(num_licenses) + (num_licenses * sizeof(struct msg_chan)) : 0;
+
+  shmid = shmget(license_key, shm_size, (num_licenses) ? IPC_CREAT | IPC_EXCL | S_IRWXU : 0);
   if(shmid == -1){
     perror(perror_buf);
     return -1;
@@ -57,6 +157,10 @@ int create_simulator(const int num_licenses){
     return -1;
   }
 
+  if((num_licenses) && (msg_remove_stale(license_key) < 0)){
+    return -1;
+  }
+
   //get the message queue
   msgid = msgget(license_key, (num_licenses) ? IPC_CREAT | IPC_EXCL | S_IRWXU : 0);
   if(msgid == -1){
@@ -72,7 +176,8 @@ int create_simulator(const int num_licenses){
 
   if(num_licenses){
     /* clear the license object */
-    bzero(simulator_obj, sizeof(struct simulator_object));
+    bzero(simulator_obj, shm_size);
+    simulator_obj->cfg.proc_limit = num_licenses;
   }
 
   return 0;
@@ -87,7 +192,7 @@ int destroy_simulator(const int num_licenses){
   }
 
   if(num_licenses > 0){
-    printf("OSS: Destroying simulator file %s\n", simulator_file);
+    log_msg(LOG_INFO, "OSS: Destroying simulator file %s\n", simulator_file);
 
 	  if(shmctl(shmid, IPC_RMID, NULL) == -1){
       perror(perror_buf);
@@ -107,8 +212,52 @@ int destroy_simulator(const int num_licenses){
   return rv;
 }
 
+int create_local_simulator(const int n){
+  simulator_obj = (struct simulator_object*) calloc(1, sizeof(struct simulator_object) + (n * sizeof(struct proc)));
+  if(simulator_obj == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+  simulator_obj->cfg.proc_limit = n;
+  return 0;
+}
+
+void destroy_local_simulator(){
+  free(simulator_obj);
+  simulator_obj = NULL;
+}
+
+void msg_init(){
+  unsigned int i;
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    struct msg_chan * chan = sim_chan(i);
+    ring_init(&chan->cmd);
+    ring_init(&chan->reply);
+  }
+}
+
+/* select the ring for a message, or NULL if it goes through SysV queue */
+static struct msg_ring * msg_ring(const struct msgbuf * buf){
+  if( (simulator_obj->cfg.transport != MSG_RING) ||
+      (buf->id < 0) || (buf->id >= simulator_obj->cfg.proc_limit)){
+    return NULL;
+  }
+
+  if(buf->mtype == TYPE_BURSTED){
+    return &sim_chan(buf->id)->reply;
+  }else if(buf->mtype > TYPE_BURSTED){  /* message to user with that pid */
+    return &sim_chan(buf->id)->cmd;
+  }
+  return NULL;
+}
+
 int msg_send(const struct msgbuf * buf){
-  if(msgsnd(msgid, buf, sizeof(int) + sizeof(struct timeval), 0) == -1){
+  struct msg_ring * ring = msg_ring(buf);
+  if(ring){
+    return ring_push(ring, buf);
+  }
+
+  if(msgsnd(msgid, buf, MSG_SIZE, 0) == -1){
     perror(perror_buf);
     return -1;
   }
@@ -116,41 +265,116 @@ int msg_send(const struct msgbuf * buf){
 }
 
 int msg_recv(struct msgbuf * buf){
-  if (msgrcv(msgid, buf, sizeof(int) + sizeof(struct timeval), buf->mtype, 0) == -1){
+  struct msg_ring * ring = msg_ring(buf);
+  if(ring){
+    return ring_pop(ring, buf, simulator_obj->cfg.msg_spin);
+  }
+
+  if (msgrcv(msgid, buf, MSG_SIZE, buf->mtype, 0) == -1){
     perror(perror_buf);
     return -1;
   }
   return 0;
 }
 
-int find_id(pid_t pid){
-  unsigned int i;
-  for(i=0; i < PROC_LIMIT; i++){
-    if(simulator_obj->procs[i].pid == pid){
-      return i;
+/* Open addressing (linear probing) index from pid to control block */
+struct pid_slot {
+  pid_t pid;  /* 0 if slot is free */
+  int id;
+};
+static struct pid_slot * pid_index = NULL;
+static unsigned int pid_index_mask = 0;
+static unsigned int pid_index_shift = 0;  /* 32 - log2 of table size */
+
+static unsigned int pid_hash(const pid_t pid){
+  /* Fibonacci hashing - top bits of the product, so sequential pids
+     spread over the table */
+  return ((uint32_t) pid * 2654435761u) >> pid_index_shift;
+}
+
+int pid_index_init(const unsigned int n){
+  unsigned int size = 2;
+
+  /* keep the load factor under 1/2 */
+  pid_index_shift = 31;
+  while(size < (2*n)){
+    size <<= 1;
+    pid_index_shift--;
+  }
+
+  pid_index = (struct pid_slot*) calloc(size, sizeof(struct pid_slot));
+  if(pid_index == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+  pid_index_mask = size - 1;
+  return 0;
+}
+
+void pid_index_free(){
+  free(pid_index);
+  pid_index = NULL;
+}
+
+int pid_index_add(const pid_t pid, const int id){
+  unsigned int i = pid_hash(pid);
+
+  while(pid_index[i].pid != 0){
+    if(pid_index[i].pid == pid){
+      break;  //update existing
     }
+    i = (i + 1) & pid_index_mask;
   }
-  return -1;
+  pid_index[i].pid = pid;
+  pid_index[i].id  = id;
+  return 0;
 }
 
-struct proc * find_proc(const pid_t pid){
-  unsigned int i;
-  for(i=0; i < PROC_LIMIT; i++){
-    if(simulator_obj->procs[i].pid == pid){
-      return &simulator_obj->procs[i];
+void pid_index_del(const pid_t pid){
+  unsigned int i = pid_hash(pid), j, h;
+
+  while(pid_index[i].pid != pid){
+    if(pid_index[i].pid == 0){
+      return; //not in index
     }
+    i = (i + 1) & pid_index_mask;
   }
-  return NULL;
+
+  /* shift back the following entries, so no probe chain is broken */
+  j = i;
+  while(1){
+    j = (j + 1) & pid_index_mask;
+    if(pid_index[j].pid == 0){
+      break;
+    }
+    h = pid_hash(pid_index[j].pid);
+    /* move entry j into hole i, if its home is not between i and j */
+    if(((j - h) & pid_index_mask) >= ((j - i) & pid_index_mask)){
+      pid_index[i] = pid_index[j];
+      i = j;
+    }
+  }
+  pid_index[i].pid = 0;
+}
+
+int find_id(pid_t pid){
+  unsigned int i = pid_hash(pid);
+
+  while(pid_index[i].pid != 0){
+    if(pid_index[i].pid == pid){
+      return pid_index[i].id;
+    }
+    i = (i + 1) & pid_index_mask;
+  }
+  return -1;
 }
 
-//Increment a timer
-void tincrement(struct timeval * t, const struct timeval * inc){
-  struct timeval tv = *t;
-  timeradd(&tv, inc, t);  //add increment to t
+struct proc * find_proc(const pid_t pid){
+  const int id = find_id(pid);
+  return (id == -1) ? NULL : &simulator_obj->procs[id];
 }
 
 //Divide a timer
-void taverage(struct timeval * t, const unsigned int x){
-  if(t->tv_sec != 0){   t->tv_sec  /= x;  }
-  if(t->tv_usec != 0){  t->tv_usec /= x;  }
+simtime_t taverage(const simtime_t t, const unsigned int x){
+  return (x == 0) ? 0 : (t / x);
 }
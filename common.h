@@ -4,11 +4,21 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include "config.h"
+#include "rng.h"
+
+/* simulated time, in nanoseconds */
+typedef uint64_t simtime_t;
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_USEC 1000ULL
+
+/* print simulated time as seconds:nanoseconds */
+#define TIME_FMT "%lu:%09lu"
+#define TIME_ARG(t) (unsigned long)((t) / NS_PER_SEC), (unsigned long)((t) % NS_PER_SEC)
 
 /* actions a process can take - execute, terminate, interrupt */
 enum proc_action {ACT_EXEC, ACT_TERM, ACT_INT};
 /* a process can be bound to CPU or IO */
-enum proc_bound {B_CPU=0, B_IO};
+enum proc_bound {B_CPU=0, B_IO, B_COUNT};
 
 /* times a process has in its control block - start, execute, wait, blocked */
 enum proc_timer {T_START=0, T_EXEC, T_WAIT, T_BLOCKED, T_BURST, T_IOEND, T_COUNT};
@@ -17,14 +27,55 @@ struct proc {
   pid_t pid;
   int id;
   enum proc_bound bound;
-  struct timeval timer[T_COUNT];
+  simtime_t timer[T_COUNT];
   /* what was last proc action */
   enum proc_action action;
+
+  /* ready queue level and links (control block indexes, -1 if none) */
+  int rq_level, rq_prev, rq_next;
+  int rq_child;               /* first child, when queue is a heap */
+  unsigned int rq_prio;       /* feedback queue level, kept while not queued */
+  simtime_t vruntime;         /* weighted runtime, for fair queue */
+  simtime_t rq_added;  /* ready queue insertion time */
+  unsigned int dispatches;    /* times process got a core */
+  /* workload replay - offset of next burst in workload file, bursts
+     left, and CPU time used of the next burst */
+  uint64_t wl_pos;
+  unsigned int wl_left;
+  simtime_t wl_used;
+  /* position in blocked queue heap, -1 if not blocked */
+  int bq_pos;
+
+  /* random streams for user decisions, seeded by oss */
+  struct rng rng[RNG_PROC_COUNT];
+};
+
+/* ready queue engines - fixed queues by bound, fair by virtual runtime,
+   or multi-level feedback */
+enum rq_engine {RQ_FIFO=0, RQ_CFS, RQ_MLFQ};
+
+/* how oss and users exchange messages */
+enum msg_transport {MSG_SYSV=0, MSG_RING};
+
+/* simulation parameters, set by oss before users attach */
+struct simulator_config {
+  unsigned int proc_limit;  /* number of control blocks */
+  unsigned int proc_total;  /* processes to start in total */
+  unsigned int slice_ns;    /* time slice per burst, in nanoseconds */
+  unsigned int rq_count;    /* number of ready queues */
+  unsigned int cores;       /* number of simulated CPUs */
+  enum rq_engine engine;    /* ready queue policy */
+  enum msg_transport transport;
+  unsigned int msg_spin;    /* ring polls before sleeping on futex */
+  unsigned int int_prob[B_COUNT];  /* percent chance to interrupt for IO, by bound */
+  uint64_t seed;            /* seed of all random streams */
+  char workload[WORKLOAD_PATH_MAX];  /* jobs to replay, empty for random ones */
 };
 
 struct simulator_object {
-  struct timeval clock;
-  struct proc procs[PROC_LIMIT];
+  struct simulator_config cfg;
+  simtime_t clock;
+  struct proc procs[];      /* cfg.proc_limit control blocks */
 };
 
 enum msg_types {
@@ -36,36 +87,63 @@ enum msg_types {
 
 struct msgbuf {
  long mtype;       /* message type, must be > 0 */
- int id;
- struct timeval slice;
+ int id;           /* control block, selects the ring channel */
+ simtime_t slice; /* 0 tells user to stop */
 };
 
 /* perror prefix */
 extern char perror_buf[100];
-/* signal handler flag for interruption */
-extern int is_signalled;
 
 /* Simulator object pointer to shared memory */
 extern struct simulator_object * simulator_obj;
 
-/* create license object*/
+/* create simulator object with n control blocks, or attach to it if n is 0 */
 int create_simulator(const int n);
 /* destroy and cler the shared memory object */
-int destroy_simulator();
+int destroy_simulator(const int n);
+
+/* select simulator instance, before it is created or attached. Each
+   instance has its own file, so many oss can run at same time */
+void simulator_instance(const unsigned int id);
 
+/* parse a positive number option into value, up to UINT_MAX. Prints
+   an error with what, and returns -1 if arg is not such a number */
+int opt_number(const char * arg, const char * what, unsigned int * value);
+
+/* file, whose name is the key for shared memory and message queue */
+const char * simulator_path();
+
+/* remove shared memory with key, if its creator is dead. Returns 1 if
+   removed, 0 if there is none, and -1 if it is in use */
+int shm_remove_stale(const key_t key);
+
+/* simulator object in private memory, for use without users */
+int create_local_simulator(const int n);
+void destroy_local_simulator();
+
+/* Send/receive a message. With ring transport, messages with mtype pid
+   or TYPE_BURSTED go through the channel of control block buf->id */
 int msg_send(const struct msgbuf * buf);
 int msg_recv(      struct msgbuf * buf);
 
+/* clear the ring channels, after oss has set the config */
+void msg_init();
+
 /* helper functions */
 
+/* pid to control block index (maintained by oss only) */
+int  pid_index_init(const unsigned int n);
+void pid_index_free();
+int  pid_index_add(const pid_t pid, const int id);
+void pid_index_del(const pid_t pid);
+
 /* find process id by its pid */
 int find_id(pid_t pid);
 
 /* Find process control block by PID */
 struct proc * find_proc(const pid_t pid);
 
-/* increment a timer */
-void tincrement(struct timeval * t, const struct timeval * inc);
-void taverage(struct timeval * t, const unsigned int x);
+/* average of a time total over x, 0 if there is nothing to average */
+simtime_t taverage(const simtime_t t, const unsigned int x);
 
 #endif
@@ -1,7 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-/* limit of processes in the system */
+/* default limit of processes in the system */
 #define PROC_LIMIT 18
 #define PROC_TOTAL 100
 
@@ -15,18 +15,58 @@
 
 #define CPUBOUND_CHANCE 30
 
-/* 500 ms time slice per burst */
-#define SLICE_NS 500000
+/* default 500 ms time slice per burst */
+#define SLICE_NS 500000000
 
-/* we have 2 ready queues - high and low */
+/* by default we have 2 ready queues - high and low, and at most 64 */
 #define RQ_COUNT 2
+#define RQ_MAX 64
 
-#define MAX_LINES 10000
+/* CFS engine - a slice is never shorter than time slice (-q) / CFS_MIN_GRAN */
+#define CFS_MIN_GRAN 8
+/* weight of nice 0, and weights of CPU and IO bound processes. They are
+   equal on purpose - like CFS, the engine doesn't favour a class, and IO
+   bound processes get ahead only by their lower vruntime after blocking.
+   Change them to weight the classes */
+#define CFS_WEIGHT_NICE0 1024
+static const unsigned int cfs_weights[2] = {1024, 1024};
 
-/* interrupt probability */
-static const unsigned int interrupt_prob[2] = {15, 60};
+/* MLFQ engine - all processes go back to top level this often (5 s) */
+#define MLFQ_BOOST_NS 5000000000ULL
+/* quantum doubles with each lower level, and stays same below this level */
+#define MLFQ_MAX_DOUBLING 16
+
+/* by default we simulate one CPU */
+#define CORE_COUNT 1
+
+/* log is rotated after this many bytes */
+#define LOG_MAX_SIZE (8 * 1024 * 1024)
+/* records in log ring (power of 2), and maximum length of one */
+#define LOG_RING_SIZE 16384
+#define LOG_RECORD_SIZE 240
+/* log writer batch size, and its sleep when ring is empty */
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_FLUSH_NS 1000000
+
+/* trace file is mapped at this size, and truncated on close */
+#define TRACE_MAX_SIZE (1UL << 30)
+
+/* oss checks signals and runtime timer every that many loops, when
+   it has no forked users to reap. Live stats are published as often */
+#define EVENT_POLL_LOOPS 64
+
+/* ring transport polls before sleeping on futex */
+#define MSG_SPIN 2000
+
+/* percent chance to interrupt for IO, of CPU and IO bound processes */
+#define INTERRUPT_PROB {15, 60}
+
+/* longest workload file path (-w), and oss drops pages of jobs it
+   has started in steps of this size */
+#define WORKLOAD_PATH_MAX 256
+#define WORKLOAD_RELEASE_SIZE (16 * 1024 * 1024)
 
 #define maxTimeBetweenNewProcsSecs 2
-#define maxTimeBetweenNewProcsNS   10000
+#define maxTimeBetweenNewProcsNS   10000000
 
 #endif
@@ -0,0 +1,76 @@
+#include <math.h>
+#include <strings.h>
+#include "hist.h"
+
+static unsigned int hist_index(const uint64_t v){
+  if(v < HIST_SUB){
+    return v;
+  }
+  /* power of 2 of value, and its top bits below the leading one */
+  const unsigned int shift = (63 - __builtin_clzll(v)) - HIST_SUB_BITS;
+  const unsigned int sub = (v >> shift) & (HIST_SUB - 1);
+  return HIST_SUB + (shift * HIST_SUB) + sub;
+}
+
+/* highest value that goes into bucket i */
+static uint64_t hist_value(const unsigned int i){
+  if(i < HIST_SUB){
+    return i;
+  }
+  const unsigned int shift = (i - HIST_SUB) / HIST_SUB;
+  const uint64_t low = (uint64_t)(HIST_SUB + ((i - HIST_SUB) % HIST_SUB)) << shift;
+  return low + ((1ULL << shift) - 1);
+}
+
+void hist_init(struct hist * h){
+  bzero(h, sizeof(struct hist));
+}
+
+void hist_add(struct hist * h, const uint64_t v){
+  if((h->count == 0) || (v < h->min)){
+    h->min = v;
+  }
+  if(v > h->max){
+    h->max = v;
+  }
+  h->count++;
+  h->sum += v;
+
+  const double delta = (double) v - h->mean;
+  h->mean += delta / h->count;
+  h->m2 += delta * ((double) v - h->mean);
+
+  h->buckets[hist_index(v)]++;
+}
+
+double hist_mean(const struct hist * h){
+  return h->mean;
+}
+
+double hist_stddev(const struct hist * h){
+  return (h->count > 1) ? sqrt(h->m2 / (h->count - 1)) : 0.0;
+}
+
+uint64_t hist_quantile(const struct hist * h, const double q){
+  unsigned int i;
+
+  if(h->count == 0){
+    return 0;
+  }
+
+  /* rank of the value we look for, 1 based */
+  uint64_t rank = (uint64_t)(q * h->count + 0.5);
+  if(rank < 1){
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for(i=0; i < HIST_BUCKETS; i++){
+    seen += h->buckets[i];
+    if(seen >= rank){
+      const uint64_t v = hist_value(i);
+      return (v < h->max) ? v : h->max;
+    }
+  }
+  return h->max;
+}
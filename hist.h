@@ -0,0 +1,28 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+
+/* Log-linear histogram of nanosecond values, like HdrHistogram.
+   Each power of 2 is split in HIST_SUB buckets, so a value is
+   recorded within 1/HIST_SUB (about 3%) of its size */
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + ((64 - HIST_SUB_BITS) * HIST_SUB))
+
+struct hist {
+  uint64_t count, sum, min, max;
+  double mean, m2;  /* running mean and squared deviations (Welford) */
+  uint64_t buckets[HIST_BUCKETS];
+};
+
+void hist_init(struct hist * h);
+void hist_add(struct hist * h, const uint64_t v);
+
+double hist_mean(const struct hist * h);
+double hist_stddev(const struct hist * h);
+
+/* value under which q (0 to 1) of the recorded values are */
+uint64_t hist_quantile(const struct hist * h, const double q);
+
+#endif
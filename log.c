@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "config.h"
+#include "common.h"
+#include "log.h"
+
+/* one formatted line in the ring */
+struct log_record {
+  uint64_t seq;   /* ring position it holds, +1 when it can be read */
+  unsigned int len;
+  char text[LOG_RECORD_SIZE];
+};
+
+static struct log_record * ring = NULL;
+static uint64_t ring_head = 0;  /* next position to reserve */
+static uint64_t ring_tail = 0;  /* next position writer reads */
+static unsigned long ring_dropped = 0;
+
+static enum log_level log_level = LOG_DEBUG;
+static char log_path[PATH_MAX];
+static unsigned long log_max_size = 0, log_size = 0;
+static int log_fd = -1;
+
+static pthread_t log_thread;
+static int log_running = 0;
+
+/* Write a batch of count records to file, rotate it if its over the size
+   limit. ends[] has the offset after each record. Records that couldn't
+   be written whole are dropped and counted */
+static void log_flush(const char * buf, const unsigned int * ends, const unsigned int count){
+  char old_path[PATH_MAX + 2];
+  const size_t len = (count > 0) ? ends[count - 1] : 0;
+  size_t off = 0;
+  unsigned int i;
+
+  while(off < len){
+    const ssize_t rv = write(log_fd, buf + off, len - off);
+    if(rv <= 0){
+      break;
+    }
+    off += rv;
+  }
+  log_size += off;
+
+  if(off < len){
+    for(i=0; (i < count) && (ends[i] <= off); i++);
+    __atomic_add_fetch(&ring_dropped, count - i, __ATOMIC_RELAXED);
+  }
+
+  if(log_max_size && (log_size >= log_max_size)){
+    /* keep one old log, and start a new one */
+    snprintf(old_path, sizeof(old_path), "%s.1", log_path);
+    if(rename(log_path, old_path) == -1){
+      fprintf(stderr, "%srename %s: %s, log rotation is off\n", perror_buf, log_path, strerror(errno));
+      log_max_size = 0;
+      return;
+    }
+
+    const int fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+      /* keep writing to the old log, under its new name */
+      fprintf(stderr, "%sopen %s: %s, log rotation is off\n", perror_buf, log_path, strerror(errno));
+      log_max_size = 0;
+      return;
+    }
+    close(log_fd);
+    log_fd = fd;
+    log_size = 0;
+  }
+}
+
+/* move ready records from ring to file, return how many */
+static unsigned int log_drain(){
+  static char batch[LOG_BATCH_SIZE];
+  static unsigned int batch_ends[LOG_RING_SIZE];  /* offset after each record */
+  size_t len = 0;
+  unsigned int n = 0, count = 0;
+
+  while(1){
+    struct log_record * r = &ring[ring_tail & (LOG_RING_SIZE - 1)];
+    if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != (ring_tail + 1)){
+      break;  /* not written yet */
+    }
+
+    if(((len + r->len) > sizeof(batch)) || (count == LOG_RING_SIZE)){
+      log_flush(batch, batch_ends, count);
+      len = 0;
+      count = 0;
+    }
+    memcpy(&batch[len], r->text, r->len);
+    len += r->len;
+    batch_ends[count++] = len;
+
+    /* free the record for position a ring lap ahead */
+    __atomic_store_n(&r->seq, ring_tail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    ring_tail++;
+    n++;
+  }
+
+  if(count > 0){
+    log_flush(batch, batch_ends, count);
+  }
+  return n;
+}
+
+static void * log_writer(void * arg){
+  const struct timespec nap = {0, LOG_FLUSH_NS};
+
+  while(__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)){
+    if(log_drain() == 0){
+      nanosleep(&nap, NULL);
+    }
+  }
+  log_drain();
+  return NULL;
+}
+
+int log_open(const char * path, const unsigned long max_size, const enum log_level level){
+  sigset_t mask, old;
+  struct stat st;
+  uint64_t i;
+
+  strncpy(log_path, path, sizeof(log_path) - 1);
+  log_max_size = max_size;
+  log_level = level;
+
+  log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if((log_fd == -1) || (fstat(log_fd, &st) == -1)){
+    perror(perror_buf);
+    return -1;
+  }
+
+  /* only a regular file is rotated, never a device like /dev/null */
+  if(!S_ISREG(st.st_mode)){
+    log_max_size = 0;
+  }
+
+  ring = (struct log_record*) malloc(sizeof(struct log_record) * LOG_RING_SIZE);
+  if(ring == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+  for(i=0; i < LOG_RING_SIZE; i++){
+    ring[i].seq = i;
+  }
+
+  /* writer thread must not take our signals */
+  sigfillset(&mask);
+  pthread_sigmask(SIG_SETMASK, &mask, &old);
+  log_running = 1;
+  const int rv = pthread_create(&log_thread, NULL, log_writer, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if(rv != 0){
+    fprintf(stderr, "%spthread_create: %s\n", perror_buf, strerror(rv));
+    log_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+void log_close(){
+  if(log_running){
+    __atomic_store_n(&log_running, 0, __ATOMIC_RELEASE);
+    pthread_join(log_thread, NULL);
+  }
+
+  if(log_fd != -1){
+    close(log_fd);
+    log_fd = -1;
+  }
+  free(ring);
+  ring = NULL;
+}
+
+unsigned long log_dropped(){
+  return __atomic_load_n(&ring_dropped, __ATOMIC_RELAXED);
+}
+
+void log_write(const enum log_level level, const char * fmt, ...){
+  va_list ap;
+
+  if(level < log_level){
+    return;
+  }
+
+  if(ring == NULL){
+    /* log isn't open (e.g in user), print directly */
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    return;
+  }
+
+  /* reserve a record - many writers can race for it, so use CAS */
+  struct log_record * r;
+  uint64_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+  while(1){
+    r = &ring[pos & (LOG_RING_SIZE - 1)];
+    const int64_t dif = (int64_t) (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+
+    if(dif == 0){
+      if(__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+        break;
+      }
+    }else if(dif < 0){
+      /* ring is full - drop debug records, wait for writer with the rest */
+      if(level == LOG_DEBUG){
+        __atomic_add_fetch(&ring_dropped, 1, __ATOMIC_RELAXED);
+        return;
+      }
+      sched_yield();
+      pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    }else{
+      pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    }
+  }
+
+  va_start(ap, fmt);
+  const int len = vsnprintf(r->text, sizeof(r->text), fmt, ap);
+  va_end(ap);
+  if(len < 0){
+    r->len = 0;
+  }else{
+    r->len = (len < (int) sizeof(r->text)) ? len : sizeof(r->text) - 1;
+  }
+
+  /* let writer have it */
+  __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,29 @@
+#ifndef LOG_H
+#define LOG_H
+
+enum log_level {LOG_DEBUG=0, LOG_INFO, LOG_WARN, LOG_ERROR, LOG_ALWAYS};
+
+/* calls below this level are compiled out, e.g. -DLOG_MIN_LEVEL=1 */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+#define log_msg(level, ...) \
+  do { if((level) >= LOG_MIN_LEVEL){ log_write((level), __VA_ARGS__); } } while(0)
+
+/* Open log file and start the writer thread. Log is rotated after
+   max_size bytes, and records under level are filtered out */
+int log_open(const char * path, const unsigned long max_size, const enum log_level level);
+
+/* flush all records, stop writer thread and close file */
+void log_close();
+
+/* Format a record into the ring. If the ring is full, debug records are
+   dropped and counted, others wait for the writer */
+void log_write(const enum log_level level, const char * fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+/* number of records dropped so far, when ring was full or write failed */
+unsigned long log_dropped();
+
+#endif
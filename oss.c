@@ -7,53 +7,279 @@
 #include <limits.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 
 #include "config.h"
 #include "common.h"
 #include "queue.h"
 #include "bv.h"
+#include "burst.h"
+#include "log.h"
+#include "trace.h"
+#include "hist.h"
+#include "stats.h"
+#include "workload.h"
+
+/* threaded, pooled and simulated users get pids above the kernel pid range */
+#define THREAD_PID_BASE (1 << 22)
+#define THREAD_STACK_SIZE (64 * 1024)
 
 /* Timers for the statistics */
 enum stat_timer {ST_WAIT, ST_EXEC, ST_CPU, ST_IDLE, ST_BLOCK0, ST_BLOCK1, ST_COUNT};
-static struct timeval stat_time[ST_COUNT];
+static simtime_t stat_time[ST_COUNT];
+
+/* Distributions of exited processes, by bound. Values are ns, except
+   dispatches, which is the count of context switches of a process */
+enum proc_stat {PS_TURNAROUND=0, PS_RESPONSE, PS_WAIT, PS_BLOCKED, PS_SWITCHES, PS_COUNT};
+static const char * proc_stat_name[PS_COUNT] = {"turnaround", "response", "ready wait", "blocked", "dispatches"};
+static struct hist stat_proc[B_COUNT][PS_COUNT];
+/* ready queue length integrated over simulated time, for its average */
+static double stat_rq_area = 0.0;
 
 /* processes counters for started and exited */
-static int proc_started = 0, proc_exited[RQ_COUNT] = {0,0};
-  const char * opt_log = LOGNAME;
+static int proc_started = 0, proc_exited[B_COUNT] = {0,0};
+static const char * opt_log = LOGNAME;
+static unsigned long opt_log_size = LOG_MAX_SIZE;  /* rotate log after this size */
+static enum log_level opt_log_level = LOG_INFO;
+static const char * opt_trace = NULL;  /* binary trace file */
+static const char * opt_json = NULL;   /* run summary for benchmarks */
+static const char * opt_checkpoint = NULL;  /* -C, saved on SIGUSR1 and when run is stopped */
+static const char * opt_restore = NULL;     /* -r, checkpoint to resume */
+static int checkpoint_requested = 0;
+/* bursts done, their dispatch round trip in wall time, and wall time of run */
+static unsigned long stat_bursts = 0;
+static simtime_t stat_rtt = 0;
+static struct timespec wall_start, wall_end;
+/* wall time of dispatch phases - slice send, wait for user reply, and accounting of burst end */
+enum stat_phase {PH_SEND, PH_REPLY, PH_ACCOUNT, PH_COUNT};
+static const char * phase_name[PH_COUNT] = {"send", "reply", "account"};
+static struct hist stat_phase[PH_COUNT];
+/* live counters in shared memory, for ossstat */
+static struct oss_stats * live_stats = NULL;
+/* simulation parameters from command line */
+static struct simulator_config opt_cfg = {PROC_LIMIT, PROC_TOTAL, SLICE_NS, RQ_COUNT, CORE_COUNT, RQ_FIFO, MSG_SYSV, MSG_SPIN, INTERRUPT_PROB, 0};
+static int opt_seeded = 0;  /* seed was given with -S */
+static int opt_total_set = 0;  /* -t was given, it limits workload jobs */
+static unsigned int opt_instance = 0;  /* -i, simulator instance */
+/* random streams of oss */
+static struct rng oss_rng[RNG_OSS_COUNT];
+
+/* how users are run - as processes, threads inside oss, or evaluated
+   in place by the discrete event engine */
+enum run_mode {MODE_PROC=0, MODE_THREAD, MODE_DES};
+static enum run_mode opt_mode = MODE_PROC;
+
+/* threaded users, by control block index */
+static pthread_t * user_threads = NULL;
+static pthread_attr_t user_attr;
+static pid_t thread_pid = THREAD_PID_BASE;  /* pid for next threaded/simulated user */
+/* finished user threads, waiting to be joined */
+static int * user_done = NULL, user_done_len = 0;
+static pthread_mutex_t user_done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  user_done_cond = PTHREAD_COND_INITIALIZER;
+
+/* Pre-forked user processes, one for each control block. A worker runs
+   processes of its control block one after another, and its last burst
+   reply releases the control block, instead of exit and waitpid */
+static int opt_pool = 0;            /* -W */
+static pid_t * workers = NULL;      /* worker pid by control block, 0 if exited */
+static unsigned int workers_alive = 0;
+
+/* simulated CPU */
+struct core {
+  int id;               /* control block running on core, -1 if free */
+  pid_t pid;
+  int replied;          /* user has sent its burst decision */
+  int reaped;           /* user exited, before its last burst ended */
+  /* user decision, saved from control block */
+  enum proc_action action;
+  simtime_t slice, burst, ioend;
+  simtime_t start;      /* dispatch time */
+  simtime_t overhead;   /* scheduler time, before burst starts */
+  simtime_t sent;       /* wall time when slice was sent */
+  simtime_t wait;       /* wall time when send returned, and wait for reply started */
+  simtime_t clock;      /* core time - when current burst ends */
+  simtime_t busy;       /* time spent dispatching and running users */
+};
+static struct core * cores = NULL;
+
+/* Pipelined dispatch - ready processes get their slice before a core is free.
+   A user decision depends only on its own random streams, so it can be
+   made early, and is applied when the process is dispatched */
+enum prefetch_state {PF_NONE=0, PF_SENT, PF_DONE};
+struct prefetch {
+  enum prefetch_state state;
+  int reaped;           /* user exited, before it was dispatched */
+  simtime_t wait;       /* wall time when slice was sent */
+};
+static struct prefetch * prefetch = NULL;  /* by control block index */
+static unsigned int prefetch_len = 0;       /* slices sent ahead */
+static unsigned int opt_pipeline = 0;       /* -P, limit of slices sent ahead */
+
+/* Signals are blocked for the whole run, and read from a signalfd.
+   With the runtime timer, they are polled through one epoll set */
+static sigset_t oldmask;
+static int signal_fd = -1, timer_fd = -1, epoll_fd = -1;
+static unsigned int opt_runtime = TIME_LIMIT;  /* -s, 0 for no limit */
+static unsigned long event_loops = 0;
+/* Scheduler loop stops at next step. Users keep replying, until
+   oss stops them with a zero slice */
+static int stop_requested = 0;
+
+static simtime_t forktime; /* next forktime */
+static uint64_t wl_next = 0;  /* workload offset of next job to start, 0 at end */
+static simtime_t opt_boost = MLFQ_BOOST_NS, boosttime;  /* priority boost period, and next boost */
+
+/* run user in a child process */
+static pid_t user_fork(const int pindex){
+  char buf[10], ibuf[10];
+
+  const pid_t pid = fork();
+  switch(pid){
+    case -1:
+      perror(perror_buf);
+      break;
+
+    case 0: /* do child runs the process */
+      /* create the argument for process */
+      snprintf(buf, sizeof(buf), "%d", pindex);
+      snprintf(ibuf, sizeof(ibuf), "%u", opt_instance);
 
-static sigset_t blockmask, oldmask;
-static struct timeval forktime; /* next forktime */
-static unsigned int num_lines = 0;  /* how many lines in log */
+      /* user gets our signal mask back. Ctrl-C goes to whole group,
+         but oss stops users itself, so they don't die mid message */
+      sigprocmask(SIG_SETMASK, &oldmask, NULL);
+      signal(SIGINT, SIG_IGN);
 
-/* block child termination signals */
-static void block_signals(){
-  sigemptyset(&blockmask);
-  sigaddset(&blockmask, SIGCHLD);
-  sigprocmask(SIG_SETMASK, &blockmask, &oldmask);
+      if(opt_pool){
+        execl("user", "user", buf, ibuf, "worker", NULL);
+      }else{
+        execl("user", "user", buf, ibuf, NULL);
+      }
+      perror(perror_buf);
+      exit(0);
+
+    default:
+      break;
+  }
+  return pid;
 }
 
-/* unblock child termination signals */
-static void unblock_signals(){
-  sigprocmask(SIG_SETMASK, &oldmask, NULL);
+static void * user_thread(void * arg){
+  const int id = (long) arg;
+
+  burst_loop(id, simulator_obj->procs[id].pid);
+
+  /* tell oss we are done */
+  pthread_mutex_lock(&user_done_lock);
+  user_done[user_done_len++] = id;
+  pthread_cond_signal(&user_done_cond);
+  pthread_mutex_unlock(&user_done_lock);
+
+  return NULL;
 }
 
-static void ln_check(){
-  if(++num_lines > MAX_LINES){
-    num_lines = 0;
-    /* redirect rest of output to null */
-    stdout = freopen("/dev/null", "w", stdout);
+/* run user as a thread inside oss */
+static pid_t user_thread_start(const int pindex){
+  sigset_t mask, old;
+  const pid_t pid = thread_pid++;
+
+  /* thread reads its pid from control block */
+  simulator_obj->procs[pindex].pid = pid;
+
+  /* signals are handled by oss, so user threads block them all */
+  sigfillset(&mask);
+  pthread_sigmask(SIG_SETMASK, &mask, &old);
+  const int rv = pthread_create(&user_threads[pindex], &user_attr, user_thread, (void*)(long) pindex);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if(rv != 0){
+    fprintf(stderr, "%spthread_create: %s\n", perror_buf, strerror(rv));
+    return -1;
   }
+  return pid;
 }
 
-static int docommand(){
+/* Start a worker for each control block */
+static int pool_start(){
+  unsigned int i;
+
+  workers = (pid_t*) calloc(simulator_obj->cfg.proc_limit, sizeof(pid_t));
+  if(workers == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    workers[i] = user_fork(i);
+    if(workers[i] == -1){
+      workers[i] = 0;
+      return -1;
+    }
+    workers_alive++;
+  }
+
+  log_msg(LOG_INFO, "OSS: Started %u pooled workers\n", workers_alive);
+  return 0;
+}
 
-  char buf[10];
+/* Give a new process to worker of its control block */
+static pid_t pool_bind(const int pindex){
+  struct msgbuf buf;
+
+  if(workers[pindex] == 0){
+    fprintf(stderr, "%sWorker of control block %d has exited\n", perror_buf, pindex);
+    return -1;
+  }
+
+  /* worker reads the process pid from control block */
+  const pid_t pid = thread_pid++;
+  simulator_obj->procs[pindex].pid = pid;
+
+  bzero(&buf, sizeof(buf));
+  buf.mtype = workers[pindex];
+  buf.id = pindex;
+  buf.slice = 1;
+  if(msg_send(&buf) == -1){
+    return -1;
+  }
+  return pid;
+}
+
+/* Stop all workers, whether they wait for a process or for a slice */
+static void pool_stop(){
+  struct msgbuf buf;
+  unsigned int i;
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    if(workers[i] == 0){
+      continue;
+    }
+
+    bzero(&buf, sizeof(buf));
+    buf.id = i;
+    if(bit_test(i)){
+      buf.mtype = simulator_obj->procs[i].pid;
+      msg_send(&buf);
+    }
+    /* rings have one channel for both, so one stop is enough */
+    if(!bit_test(i) || (simulator_obj->cfg.transport != MSG_RING)){
+      buf.mtype = workers[i];
+      msg_send(&buf);
+    }
+  }
+}
+
+static int docommand(){
 
   //get child id (process table index)
   const int pindex = bv_index();
   if(pindex == -1){ //if not control blocks are free
 
-    ln_check(); printf("OSS: No free control blocks at time %li:%li\n", simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+    log_msg(LOG_INFO, "OSS: No free control blocks at time " TIME_FMT "\n", TIME_ARG(simulator_obj->clock));
     return 0; //no process started
   }
   struct proc * proc = &simulator_obj->procs[pindex];
@@ -61,49 +287,150 @@ static int docommand(){
   bzero(proc, sizeof(struct proc));
   /* parent fills the user details */
   proc->id  = pindex;
+  bzero(&prefetch[pindex], sizeof(struct prefetch));
+  queues_proc_init(proc);
   proc->timer[T_START] = simulator_obj->clock;
-  /* randomly select bound of process */
-  proc->bound = ((rand() % 100) < CPUBOUND_CHANCE) ? B_CPU : B_IO;
 
-  const pid_t pid = fork();
-  switch(pid){
-    case -1:
-      perror(perror_buf);
+  if(workload_count() > 0){
+    /* job from workload. It starts at its arrival, so its turnaround
+       includes the wait for a free control block */
+    const struct workload_job * job = workload_job(wl_next);
+    if(job == NULL){
+      fprintf(stderr, "%sWorkload job at offset %llu is truncated\n", perror_buf, (unsigned long long) wl_next);
       return -1;
+    }
+    proc->timer[T_START] = job->arrival;
+    proc->bound = (job->bound == B_CPU) ? B_CPU : B_IO;
+    proc->wl_pos = wl_next + sizeof(struct workload_job);
+    proc->wl_left = job->bursts;
+  }else{
+    /* randomly select bound of process */
+    proc->bound = (rng_below(&oss_rng[RNG_BOUND], 100) < CPUBOUND_CHANCE) ? B_CPU : B_IO;
+  }
 
-    case 0: /* do child runs the process */
-      /* create the argument for process */
-      snprintf(buf, sizeof(buf), "%d", pindex);
+  /* each process gets its own streams, keyed by start order (stream 0 is oss) */
+  int i;
+  for(i=0; i < RNG_PROC_COUNT; i++){
+    rng_seed(&proc->rng[i], simulator_obj->cfg.seed, proc_started + 1, i);
+  }
 
-      unblock_signals();
+  pid_t pid;
+  switch(opt_mode){
+    case MODE_THREAD: pid = user_thread_start(pindex); break;
+    case MODE_DES:    pid = thread_pid++;              break;
+    default:          pid = (opt_pool) ? pool_bind(pindex) : user_fork(pindex); break;
+  }
+  if(pid == -1){
+    return -1;
+  }
 
-      execl("user", "user", buf, NULL);
-      perror(perror_buf);
-      exit(0);
+  proc->pid = pid;
+  pid_index_add(pid, pindex);
+  trace_add(TR_FORK, pindex, simulator_obj->clock, 0);
+  log_msg(LOG_INFO, "OSS: Generating process with PID %d at time " TIME_FMT "\n", pid, TIME_ARG(simulator_obj->clock));
+  /* push at end of ready queue */
+  rq_push(pindex);
+  return 1;
+}
 
-    default:
-      proc->pid = pid;
-      ln_check(); printf("OSS: Generating process with PID %d at time %li:%li\n", pid, simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
-      /* push at end of ready queue */
-      rq_push(pid);
-      return 1;
+/* Move to next job of workload, it is started at its arrival time */
+static int workload_seek(const uint64_t off){
+  wl_next = off;
+  if(wl_next == 0){
+    return 0;   /* no jobs left */
+  }
+
+  const struct workload_job * job = workload_job(wl_next);
+  if(job == NULL){
+    fprintf(stderr, "%sWorkload job at offset %llu is truncated\n", perror_buf, (unsigned long long) wl_next);
+    return -1;
   }
+  forktime = job->arrival;
 
+  /* jobs before it are not read again by oss */
+  workload_release(wl_next);
   return 0;
 }
 
 static void stat_onexit(struct proc * proc){
+  struct hist * h = stat_proc[proc->bound];
+
+  hist_add(&h[PS_TURNAROUND], simulator_obj->clock - proc->timer[T_START]);
+  hist_add(&h[PS_WAIT], proc->timer[T_WAIT]);
+  hist_add(&h[PS_BLOCKED], proc->timer[T_BLOCKED]);
+  hist_add(&h[PS_SWITCHES], proc->dispatches);
+
   /* update wait time */
-  tincrement(&stat_time[ST_WAIT], &proc->timer[T_WAIT]);
+  stat_time[ST_WAIT] += proc->timer[T_WAIT];
   /* update blocked time */
-  tincrement(&stat_time[ST_BLOCK0 + proc->bound], &proc->timer[T_BLOCKED]);
+  stat_time[ST_BLOCK0 + proc->bound] += proc->timer[T_BLOCKED];
   /* update execution time */
-  tincrement(&stat_time[ST_EXEC], &proc->timer[T_EXEC]);
+  stat_time[ST_EXEC] += proc->timer[T_EXEC];
 
-  ln_check(); printf("OSS: Process %d exited with times : waiting=%li:%li, blocked=%li:%li, exec=%li:%li\n",
-    proc->pid, proc->timer[T_WAIT].tv_sec,  proc->timer[T_WAIT].tv_usec,
-               proc->timer[T_BURST].tv_sec, proc->timer[T_BURST].tv_usec,
-               proc->timer[T_EXEC].tv_sec,  proc->timer[T_EXEC].tv_usec);
+  log_msg(LOG_INFO, "OSS: Process %d exited with times : waiting=" TIME_FMT ", blocked=" TIME_FMT ", exec=" TIME_FMT "\n",
+    proc->pid, TIME_ARG(proc->timer[T_WAIT]),
+               TIME_ARG(proc->timer[T_BLOCKED]),
+               TIME_ARG(proc->timer[T_EXEC]));
+}
+
+/* Release control block of a process that exited */
+static void proc_onexit(const int pindex){
+  struct proc * proc = &simulator_obj->procs[pindex];
+
+  /* update simulation statistics with process times */
+  stat_onexit(proc);
+  trace_add(TR_EXIT, pindex, simulator_obj->clock, 0);
+
+  /* drop it from ready and blocked queues */
+  queue_flush(pindex);
+  pid_index_del(proc->pid);
+
+  proc_exited[proc->bound]++;
+
+  /* mark the process as unused in bitvector */
+  bv_off(pindex);
+}
+
+/* Find core running a control block */
+static int core_find(const int id){
+  unsigned int c;
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    if(cores[c].id == id){
+      return c;
+    }
+  }
+  return -1;
+}
+
+/* User has exited. If its last burst hasn't ended, release it at burst end */
+static void proc_reaped(const int pindex){
+  const int c = core_find(pindex);
+  if(c != -1){
+    cores[c].reaped = 1;
+    return;
+  }
+  if(prefetch[pindex].state != PF_NONE){
+    prefetch[pindex].reaped = 1;
+    return;
+  }
+  proc_onexit(pindex);
+}
+
+/* Worker has exited, release the process it was running */
+static void worker_exited(const pid_t pid){
+  unsigned int i;
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    if(workers[i] == pid){
+      workers[i] = 0;
+      workers_alive--;
+      if(bit_test(i)){
+        proc_reaped(i);
+      }
+      return;
+    }
+  }
+  log_msg(LOG_WARN, "OSS: PID=%d is not a worker\n", pid);
 }
 
 static void do_wait(const int flags){
@@ -111,211 +438,680 @@ static void do_wait(const int flags){
   int status;
   while((pid = waitpid(-1, &status, flags)) > 0){
 
+    if(opt_pool){
+      worker_exited(pid);
+      continue;
+    }
+
     const int pindex = find_id(pid);
 
     if(pindex >= 0){ /* if process is found */
-      struct proc * proc = &simulator_obj->procs[pindex];
+      proc_reaped(pindex);
+    }else{
+      log_msg(LOG_WARN, "OSS: PID=%d not found in procs[]\n", pid);
+    }
+  }
+}
 
-      /* update simulation statistics with process times */
-      stat_onexit(proc);
+/* Join finished user threads, wait for one if block is set */
+static void do_join(const int block){
+  int pindex;
 
-      proc_exited[proc->bound]++;
+  pthread_mutex_lock(&user_done_lock);
+  while(block && (user_done_len == 0)){
+    pthread_cond_wait(&user_done_cond, &user_done_lock);
+  }
 
-      /* mark the process as unused in bitvector */
-      bv_off(pindex);
+  while(user_done_len > 0){
+    pindex = user_done[--user_done_len];
+    pthread_mutex_unlock(&user_done_lock);
 
-    }else{
-      ln_check(); printf("OSS: PID=%d not found in procs[]\n", pid);
+    pthread_join(user_threads[pindex], NULL);
+    proc_reaped(pindex);
+
+    pthread_mutex_lock(&user_done_lock);
+  }
+  pthread_mutex_unlock(&user_done_lock);
+}
+
+/* Send a zero slice to running users, so they stop */
+static void users_stop(){
+  struct msgbuf buf;
+  unsigned int i;
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    if(bit_test(i)){
+      bzero(&buf, sizeof(buf));
+      buf.mtype = simulator_obj->procs[i].pid;
+      buf.id = i;
+      msg_send(&buf);
     }
   }
 }
 
-static void on_interrupt(const int sig){
+/* Block signals we handle, and set up the signalfd, runtime timer and epoll set */
+static int events_init(){
+  struct epoll_event ev;
+  sigset_t mask;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGALRM);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGUSR1);
+  if(sigprocmask(SIG_BLOCK, &mask, &oldmask) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+
+  signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if((signal_fd == -1) || (timer_fd == -1) || (epoll_fd == -1)){
+    perror(perror_buf);
+    return -1;
+  }
+
+  /* zero runtime leaves timer disarmed, like alarm(0) */
+  struct itimerspec its;
+  bzero(&its, sizeof(its));
+  its.it_value.tv_sec = opt_runtime;
+  if(timerfd_settime(timer_fd, 0, &its, NULL) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = signal_fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+  ev.data.fd = timer_fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+  return 0;
+}
+
+static void events_close(){
+  close(epoll_fd);
+  close(timer_fd);
+  close(signal_fd);
+}
+
+/* Read pending signals */
+static int events_signals(){
+  struct signalfd_siginfo si;
+  int child = 0;
+
+  while(read(signal_fd, &si, sizeof(si)) == sizeof(si)){
+    switch(si.ssi_signo){
+      case SIGINT:
+        stop_requested = 1;
+        fprintf(stderr, "P%d: Ctrl-C received\n", getpid());
+        break;
+
+      case SIGTERM:
+        stop_requested = 1;
+        fprintf(stderr, "P%d: SIGTERM received\n", getpid());
+        break;
 
-  block_signals();
+      case SIGALRM:
+        stop_requested = 1;
+        break;
 
+      case SIGCHLD:
+        child = 1;
+        break;
+
+      case SIGUSR1:
+        if(opt_checkpoint){
+          checkpoint_requested = 1;
+        }else{
+          log_msg(LOG_WARN, "OSS: SIGUSR1 ignored, no checkpoint file given with -C\n");
+        }
+        break;
+    }
+  }
+  return child;
+}
 
-  if(sig == SIGINT){
-    /* raise the interrupt flag */
-    is_signalled = 1;
-    fprintf(stderr, "P%d: Ctrl-C received\n", getpid());
-  }else if(sig == SIGALRM){
-    /* send termination signal to all child processes */
-    kill(0, SIGTERM);
-    is_signalled = 1;
+/* Handle signals and runtime timer, waiting at most timeout ms.
+   Exited children are reaped all at once */
+static void events_poll(const int timeout){
+  struct epoll_event ev[2];
+  uint64_t expired;
+  int i, child = 0;
+
+  const int n = epoll_wait(epoll_fd, ev, 2, timeout);
+  for(i=0; i < n; i++){
+    if(ev[i].data.fd == signal_fd){
+      child |= events_signals();
+    }else if((ev[i].data.fd == timer_fd) && (read(timer_fd, &expired, sizeof(expired)) == sizeof(expired))){
+      log_msg(LOG_INFO, "OSS: Runtime limit of %u seconds reached\n", opt_runtime);
+      stop_requested = 1;
+    }
+  }
 
-  }else if(sig == SIGTERM){
-    /* raise the interrupt flag */
-    is_signalled = 1;
-    fprintf(stderr, "P%d: SIGTERM received\n", getpid());
-  }else if(sig == SIGCHLD){
+  if(child && (opt_mode == MODE_PROC)){
     do_wait(WNOHANG);
   }
+}
 
-  unblock_signals();
+/* Monotonic wall time in nanoseconds */
+static simtime_t wall_time(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
 }
 
-/* Exchange messages with the scheduled user */
-static int scheduler_msg(const pid_t pid){
-  struct msgbuf buf;
-  struct timeval tv;
+/* Wall time for measuring dispatch, which has no real cost in DES mode */
+static simtime_t dispatch_time(){
+  if(opt_mode == MODE_DES){
+    return 0;
+  }
+  return wall_time();
+}
+
+/* Save the user decision in core, and compute when its burst ends */
+static void core_burst(struct core * core){
+  struct proc * proc = &simulator_obj->procs[core->id];
+
+  /* control block can be reused, before burst end is reached */
+  core->action = proc->action;
+  core->burst  = proc->timer[T_BURST];
+  core->ioend  = proc->timer[T_IOEND];
+  core->replied = 1;
+
+  /* dispatch took the message round trip, and then user ran */
+  const simtime_t rtt = dispatch_time() - core->sent;
+  const simtime_t dispatch = core->overhead + rtt;
+  stat_bursts++;
+  stat_rtt += rtt;
+  core->clock = core->start + dispatch + core->burst;
+  core->busy += dispatch + core->burst;
+
+  proc->timer[T_EXEC] += core->burst;  //increment execution time with process burst
+  trace_add(TR_BURST, core->id, core->clock - core->burst, core->burst);
+
+  log_msg(LOG_DEBUG, "OSS: Dispatching of process with PID %d took " TIME_FMT ", burst ends at " TIME_FMT "\n",
+    core->pid, TIME_ARG(dispatch), TIME_ARG(core->clock));
+}
 
-  struct proc * proc = find_proc(pid);
+/* Give a slice to user, without waiting for its reply.
+   Wall time when send returned is saved in wait */
+static int slice_send(const int id, const simtime_t slice, simtime_t * wait){
+  struct msgbuf buf;
 
-  /* make a message with timeslice */
   bzero(&buf, sizeof(buf));
-  buf.slice.tv_usec = SLICE_NS;
+  buf.mtype = simulator_obj->procs[id].pid;
+  buf.id = id;
+  buf.slice = slice;
 
-  /* give a slice to user */
-  buf.mtype = pid;
+  const simtime_t t = wall_time();
   if(msg_send(&buf) == -1){
     perror(perror_buf);
     return -1;
   }
+  *wait = wall_time();
+  hist_add(&stat_phase[PH_SEND], *wait - t);
+  return 0;
+}
 
-  /* now wait for the reply from user */
-  buf.mtype = TYPE_BURSTED;
-  if(msg_recv(&buf) == -1){
-    perror(perror_buf);
-    return -1;
+/* Give a slice to the user on a free core. Its reply is collected later,
+   so users on different cores run at same time */
+static int core_dispatch(const int c, const int id){
+  struct core * core = &cores[c];
+  struct proc * proc = &simulator_obj->procs[id];
+
+  core->id  = id;
+  core->pid = proc->pid;
+  core->start = simulator_obj->clock;
+  core->replied = 0;
+  core->reaped = 0;
+  core->slice = rq_slice(id);
+  if(proc->dispatches++ == 0){
+    /* first response, from arrival to first dispatch */
+    hist_add(&stat_proc[proc->bound][PS_RESPONSE], simulator_obj->clock - proc->timer[T_START]);
+  }
+  /* scheduler overhead */
+  core->overhead  = rng_below(&oss_rng[RNG_ADVANCE], 2) * NS_PER_SEC;     //[0, 1] s
+  core->overhead += rng_below(&oss_rng[RNG_ADVANCE], 1000) * NS_PER_USEC; //[0, 1000) us
+
+  trace_add(TR_DISPATCH, id, simulator_obj->clock, c);
+  log_msg(LOG_DEBUG, "OSS: Dispatching process with PID %d on CPU %d at time " TIME_FMT "\n",
+    core->pid, c, TIME_ARG(simulator_obj->clock));
+
+  core->sent = dispatch_time();
+
+  if(opt_mode == MODE_DES){
+    /* no user to talk to, make its decision here. DES reads no wall
+       clock per burst, so dispatch phases are not timed */
+    burst_decide(proc, core->slice);
+    core_burst(core);
+    return 0;
   }
 
-  tincrement(&proc->timer[T_EXEC], &proc->timer[T_BURST]);  //increment execution time with process burst
+  if(prefetch[id].state != PF_NONE){
+    /* slice was sent ahead, core takes over its reply */
+    const int done = (prefetch[id].state == PF_DONE);
+    core->reaped = prefetch[id].reaped;
+    core->wait = prefetch[id].wait;
+    bzero(&prefetch[id], sizeof(struct prefetch));
+    prefetch_len--;
 
-  switch(proc->action){
+    if(done){
+      core_burst(core);
+    }
+    return 0;
+  }
 
-    case ACT_EXEC:
-      ln_check(); printf("OSS: Receiving that process with PID %d ran for %li nanoseconds\n", pid, proc->timer[T_BURST].tv_usec);
-      if(proc->timer[T_BURST].tv_usec != SLICE_NS){
-        ln_check(); printf("OSS: not using its entire time quantum\n");
+  return slice_send(id, core->slice, &core->wait);
+}
+
+/* Send slices ahead to processes, that are next in ready queue.
+   Only for fixed slice, which doesn't change until dispatch */
+static int scheduler_prefetch(){
+  int id = -1;
+
+  while((prefetch_len < opt_pipeline) && ((id = rq_walk(id)) != -1)){
+    if(prefetch[id].state == PF_NONE){
+      if(slice_send(id, simulator_obj->cfg.slice_ns, &prefetch[id].wait) < 0){
+        return -1;
       }
+      prefetch[id].state = PF_SENT;
+      prefetch_len++;
+    }
+  }
+  return 0;
+}
 
-      tincrement(&simulator_obj->clock, &proc->timer[T_BURST]);
+/* Wait for replies from all dispatched users */
+static int core_collect(){
+  struct msgbuf buf;
+  unsigned int c, n = 0;
 
-      rq_push(pid);
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    if((cores[c].id != -1) && !cores[c].replied){
+      n++;
+    }
+  }
+
+  c = 0;
+  while(n > 0){
+    /* next core, that is waiting for reply */
+    while((cores[c].id == -1) || cores[c].replied){
+      c++;
+    }
+
+    buf.mtype = TYPE_BURSTED;
+    buf.id = cores[c].id;
+    if(msg_recv(&buf) == -1){
+      perror(perror_buf);
+      return -1;
+    }
+
+    /* message queue replies come in any order */
+    const int r = core_find(buf.id);
+    if((r == -1) && (buf.id >= 0) && (buf.id < simulator_obj->cfg.proc_limit) &&
+       (prefetch[buf.id].state == PF_SENT)){
+      /* decision is kept in control block, until process is dispatched */
+      prefetch[buf.id].state = PF_DONE;
+      hist_add(&stat_phase[PH_REPLY], wall_time() - prefetch[buf.id].wait);
+      continue;
+    }
+    if((r == -1) || cores[r].replied){
+      log_msg(LOG_WARN, "OSS: Reply from control block %d, which is not dispatched\n", buf.id);
+      continue;
+    }
+    hist_add(&stat_phase[PH_REPLY], wall_time() - cores[r].wait);
+    core_burst(&cores[r]);
+    n--;
+  }
+
+  return 0;
+}
+
+/* Act on user decision, when its burst ends */
+static void core_complete(const int c){
+  struct core * core = &cores[c];
+  const int id = core->id;
+  simtime_t tv;
+
+  core->id = -1;
+  rq_account(id, core->burst, core->action);
+
+  switch(core->action){
+
+    case ACT_EXEC:
+      log_msg(LOG_DEBUG, "OSS: Receiving that process with PID %d ran for %lu nanoseconds on CPU %d\n", core->pid, (unsigned long) core->burst, c);
+      if(core->burst != core->slice){
+        log_msg(LOG_DEBUG, "OSS: not using its entire time quantum\n");
+      }
+      rq_push(id);
+      break;
 
     case ACT_TERM:
-      ln_check(); printf("OSS: Receiving that process with PID %d terminated after running for %li nanoseconds\n", pid, proc->timer[T_BURST].tv_usec);
-      tincrement(&simulator_obj->clock, &proc->timer[T_BURST]);  //increment clock with process burst
+      log_msg(LOG_INFO, "OSS: Receiving that process with PID %d terminated after running for %lu nanoseconds on CPU %d\n", core->pid, (unsigned long) core->burst, c);
+      if((opt_mode == MODE_DES) || opt_pool || core->reaped){
+        /* simulated or pooled process exits right after its last burst */
+        proc_onexit(id);
+      }
       break;
 
     case ACT_INT:
       /* calculate the IO end time */
-      timeradd(&simulator_obj->clock, &proc->timer[T_IOEND], &tv);
-
-      /* advance clock with burst time */
-      ln_check(); printf("OSS: Advance with burst of %li:%li at time %li:%li\n",
-        proc->timer[T_BURST].tv_sec, proc->timer[T_BURST].tv_usec,
-        simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
-
-      tincrement(&simulator_obj->clock, &proc->timer[T_BURST]);
-
-      ln_check(); printf("OSS: Putting process with PID %d into blocked queue until %li:%li\n", pid, tv.tv_sec, tv.tv_usec);
+      tv = simulator_obj->clock + core->ioend;
+      log_msg(LOG_DEBUG, "OSS: Putting process with PID %d into blocked queue until " TIME_FMT "\n", core->pid, TIME_ARG(tv));
 
       /* put process at blocked queue */
-      bq_push(pid, tv);
+      bq_push(id, tv);
       break;
   }
-
-  return 0;
 }
 
-/* Wake a process from ready and blocked queues */
+/* Dispatch processes on free cores - unblocked ones first, then from ready queue */
 static int scheduler_wakeup(){
-  struct timeval t1, t2, t3;
+  unsigned int c;
+  int id;
 
-  int nq = 0;
-
-  gettimeofday(&t1, NULL);
+  if(simulator_obj->cfg.engine != RQ_FIFO){
+    /* woken processes compete with others in ready queue */
+    while((id = bq_pop()) != -1){
+      rq_push(id);
+    }
+  }
 
-  /* First try to pop from ready queue */
-  pid_t pid = rq_pop();
-  if(pid > 0){
-    nq = scheduler_msg(pid);
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    if(cores[c].id != -1){
+      continue;
+    }
 
-    gettimeofday(&t2, NULL);
-    timersub(&t2, &t1, &t3);
+    id = bq_pop();
+    if(id == -1){
+      id = rq_pop();
+      if(id == -1){
+        break;  /* nothing to dispatch */
+      }
+    }
 
-    /* update time with dispatch duration */
-    tincrement(&simulator_obj->clock, &t3);
-    ln_check(); printf("OSS: Dispatching of ready queue took %li:%li at %li:%li\n", t3.tv_sec, t3.tv_usec, simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+    if(core_dispatch(c, id) < 0){
+      return -1;
+    }
   }
 
-  /* next try the blocked queue */
-  gettimeofday(&t1, NULL);
-  pid = bq_pop();
-  if(pid > 0){
-    ln_check(); printf("OSS: Dispatching process with PID %d from blocked queue at time %li:%li,\n", pid, simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
-    nq += scheduler_msg(pid);
-
-    gettimeofday(&t2, NULL);
-    timersub(&t2, &t1, &t3);
-
-    /* update time with dispatch duration */
-    tincrement(&simulator_obj->clock, &t3);
-    ln_check(); printf("OSS: Dispatching of blocked queue took %li:%li at time %li:%li\n", t3.tv_sec, t3.tv_usec, simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+  if((opt_mode != MODE_DES) && (scheduler_prefetch() < 0)){
+    return -1;
   }
 
-  return nq;
+  return core_collect();
 }
 
 /* check number of arguments*/
 static int check_arguments(const int argc, char * const argv[]){
-  int rtime = TIME_LIMIT;
-
   int opt;
-  while((opt = getopt(argc, argv, "hs:l:")) != -1){
+  while((opt = getopt(argc, argv, "hs:l:p:t:q:k:c:P:e:b:I:i:fWTDS:v:z:x:j:C:r:w:")) != -1){
       switch(opt){
 
         case 's':
-          rtime = atoi(optarg);
-          if(rtime < 0){
+          if(atoi(optarg) < 0){
             fprintf(stderr, "Error: Invalid runtime\n");
             return -1;
           }
+          opt_runtime = atoi(optarg);
           break;
 
         case 'l':
           opt_log = optarg;
           break;
 
+        case 'p':
+          if(opt_number(optarg, "process limit", &opt_cfg.proc_limit) < 0){
+            return -1;
+          }
+          break;
+
+        case 't':
+          if(opt_number(optarg, "total processes", &opt_cfg.proc_total) < 0){
+            return -1;
+          }
+          opt_total_set = 1;
+          break;
+
+        case 'q':
+          if(opt_number(optarg, "time slice", &opt_cfg.slice_ns) < 0){
+            return -1;
+          }
+          break;
+
+        case 'k':
+          if( (opt_number(optarg, "queue count", &opt_cfg.rq_count) < 0) ||
+              (opt_cfg.rq_count > RQ_MAX)){
+            fprintf(stderr, "Error: Queue count must be in [1, %d]\n", RQ_MAX);
+            return -1;
+          }
+          break;
+
+        case 'c':
+          if(opt_number(optarg, "core count", &opt_cfg.cores) < 0){
+            return -1;
+          }
+          break;
+
+        case 'P':
+          if(opt_number(optarg, "pipeline depth", &opt_pipeline) < 0){
+            return -1;
+          }
+          break;
+
+        case 'e':
+          if(strcmp(optarg, "fifo") == 0){
+            opt_cfg.engine = RQ_FIFO;
+          }else if(strcmp(optarg, "cfs") == 0){
+            opt_cfg.engine = RQ_CFS;
+          }else if(strcmp(optarg, "mlfq") == 0){
+            opt_cfg.engine = RQ_MLFQ;
+          }else{
+            fprintf(stderr, "Error: Unknown ready queue engine %s\n", optarg);
+            return -1;
+          }
+          break;
+
+        case 'I':
+          if( (sscanf(optarg, "%u,%u", &opt_cfg.int_prob[B_CPU], &opt_cfg.int_prob[B_IO]) != 2) ||
+              (opt_cfg.int_prob[B_CPU] > 100) || (opt_cfg.int_prob[B_IO] > 100)){
+            fprintf(stderr, "Error: Interrupt chances must be cpu,io percents\n");
+            return -1;
+          }
+          break;
+
+        case 'i':
+          /* 0 is the default run, so other instances are above it */
+          if(opt_number(optarg, "simulator instance", &opt_instance) < 0){
+            return -1;
+          }
+          break;
+
+        case 'f':
+          opt_cfg.transport = MSG_RING;
+          /* spinning only helps, if the other side can run meanwhile */
+          if(sysconf(_SC_NPROCESSORS_ONLN) < 2){
+            opt_cfg.msg_spin = 0;
+          }
+          break;
+
+        case 'W':
+          opt_pool = 1;
+          break;
+
+        case 'T':
+          opt_mode = MODE_THREAD;
+          break;
+
+        case 'D':
+          opt_mode = MODE_DES;
+          break;
+
+        case 'S':
+          opt_cfg.seed = strtoull(optarg, NULL, 0);
+          opt_seeded = 1;
+          break;
+
+        case 'v':
+          opt_log_level = atoi(optarg);
+          if((opt_log_level < LOG_DEBUG) || (opt_log_level > LOG_ALWAYS)){
+            fprintf(stderr, "Error: Invalid log level\n");
+            return -1;
+          }
+          break;
+
+        case 'z':
+          opt_log_size = strtoul(optarg, NULL, 0);
+          break;
+
+        case 'b':
+          opt_boost = strtoull(optarg, NULL, 0);
+          break;
+
+        case 'x':
+          opt_trace = optarg;
+          break;
+
+        case 'j':
+          opt_json = optarg;
+          break;
+
+        case 'C':
+          opt_checkpoint = optarg;
+          break;
+
+        case 'w':
+          if(strlen(optarg) >= WORKLOAD_PATH_MAX){
+            fprintf(stderr, "Error: Workload path is longer than %d\n", WORKLOAD_PATH_MAX - 1);
+            return -1;
+          }
+          strcpy(opt_cfg.workload, optarg);
+          break;
+
+        case 'r':
+          opt_restore = optarg;
+          break;
+
         case 'h':
         default:
-          fprintf(stderr, "Usage: ./oss [-h] [-s seconds] [-l logfile.txt]\n");
-          return EXIT_FAILURE;
+          fprintf(stderr, "Usage: ./oss [-h] [-s seconds] [-l logfile.txt] [-p limit] [-t total] [-q slice] [-k queues] [-c cores] [-P depth] [-e engine] [-b boost] [-I cpu,io] [-i instance] [-f] [-W] [-T] [-D] [-S seed] [-v level] [-z bytes] [-x trace.bin] [-j summary.json] [-C checkpoint] [-r checkpoint] [-w workload.bin]\n");
+          fprintf(stderr, "\t-p Processes running at same time (%d)\n", PROC_LIMIT);
+          fprintf(stderr, "\t-t Processes to start in total (%d)\n", PROC_TOTAL);
+          fprintf(stderr, "\t-q Time slice per burst, in nanoseconds (%d)\n", SLICE_NS);
+          fprintf(stderr, "\t-k Number of ready queues, or MLFQ levels (%d)\n", RQ_COUNT);
+          fprintf(stderr, "\t-c Number of simulated CPUs (%d)\n", CORE_COUNT);
+          fprintf(stderr, "\t-P Slices sent ahead to ready processes (0)\n");
+          fprintf(stderr, "\t-e Ready queue engine - fifo, cfs or mlfq (fifo)\n");
+          fprintf(stderr, "\t-b MLFQ priority boost period in nanoseconds, 0 to never (%llu)\n", MLFQ_BOOST_NS);
+          fprintf(stderr, "\t-I Percent chance to interrupt for IO, of CPU and IO bound processes (15,60)\n");
+          fprintf(stderr, "\t-i Simulator instance above 0, to run many oss at same time (0)\n");
+          fprintf(stderr, "\t-f Use shared memory rings instead of message queue\n");
+          fprintf(stderr, "\t-W Pre-fork a pool of user processes, and reuse them\n");
+          fprintf(stderr, "\t-T Run users as threads inside oss\n");
+          fprintf(stderr, "\t-D Discrete event simulation, without real users\n");
+          fprintf(stderr, "\t-S Seed for random streams (time and pid)\n");
+          fprintf(stderr, "\t-v Log level, 0=debug to 4=stats only (1)\n");
+          fprintf(stderr, "\t-z Rotate log after that many bytes, 0 to never (%d)\n", LOG_MAX_SIZE);
+          fprintf(stderr, "\t-x Write binary scheduling trace, see osstrace\n");
+          fprintf(stderr, "\t-j Write run summary as JSON, see ossbench\n");
+          fprintf(stderr, "\t-C Save checkpoint on SIGUSR1, and when run is stopped early\n");
+          fprintf(stderr, "\t-r Resume from checkpoint, with its simulation parameters, -b and -P\n");
+          fprintf(stderr, "\t-w Replay jobs of workload file, or first -t of them, see wlconv\n");
+          return -1;
       }
   }
 
-  /* redirect output to log */
-  stdout = freopen(opt_log, "w", stdout);
-  if(stdout == NULL){
-    perror("freopen");
-    return -1;
+  if((opt_pipeline > 0) && (opt_cfg.engine != RQ_FIFO)){
+    fprintf(stderr, "Warning: -P needs a fixed slice, so it is off for this engine\n");
+    opt_pipeline = 0;
+  }
+
+  if(opt_pool && (opt_mode != MODE_PROC)){
+    fprintf(stderr, "Warning: -W pools user processes, so it is off with -T and -D\n");
+    opt_pool = 0;
   }
 
-  alarm(rtime);
+  if(!opt_seeded){
+    opt_cfg.seed = ((uint64_t) time(NULL) << 20) ^ getpid();
+  }
 
   return 0;
 }
 
 static int scheduler_init(){
   struct msgbuf buf;
+  int i;
 
   bzero(&buf, sizeof(buf));
 
   /* insert one execute message, so a process can start */
   buf.mtype = TYPE_EXECUTE;
-  if(msg_send(&buf) == -1){
+  if((opt_mode != MODE_DES) && (msg_send(&buf) == -1)){
     return -1;
   }
 
-  /* init bit vector and queue */
-  bv_init();
-  queues_init();
+  /* init bit vector, queue and pid index */
+  if( (bv_init(simulator_obj->cfg.proc_limit) < 0) ||
+      (queues_init() < 0) ||
+      (pid_index_init(simulator_obj->cfg.proc_limit) < 0)){
+    return -1;
+  }
+
+  cores = (struct core*) calloc(simulator_obj->cfg.cores, sizeof(struct core));
+  if(cores == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+  for(i=0; i < simulator_obj->cfg.cores; i++){
+    cores[i].id = -1;
+  }
+
+  prefetch = (struct prefetch*) calloc(simulator_obj->cfg.proc_limit, sizeof(struct prefetch));
+  if(prefetch == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  if(opt_mode == MODE_THREAD){
+    user_threads = (pthread_t*) calloc(simulator_obj->cfg.proc_limit, sizeof(pthread_t));
+    user_done = (int*) calloc(simulator_obj->cfg.proc_limit, sizeof(int));
+    if((user_threads == NULL) || (user_done == NULL)){
+      perror(perror_buf);
+      return -1;
+    }
+    pthread_attr_init(&user_attr);
+    pthread_attr_setstacksize(&user_attr, THREAD_STACK_SIZE);
+  }
+
+  /* seed the oss streams, and save seed in log so run can be repeated */
+  for(i=0; i < RNG_OSS_COUNT; i++){
+    rng_seed(&oss_rng[i], simulator_obj->cfg.seed, 0, i);
+  }
+  log_msg(LOG_ALWAYS, "OSS: Random seed is %llu\n", (unsigned long long) simulator_obj->cfg.seed);
+  if(workload_count() > 0){
+    log_msg(LOG_ALWAYS, "OSS: Replaying %u of %llu jobs from %s\n", simulator_obj->cfg.proc_total,
+      (unsigned long long) workload_count(), simulator_obj->cfg.workload);
+  }
 
   /* init timers */
   bzero(stat_time, sizeof(stat_time));
-  timerclear(&forktime);
+  forktime = 0;
+  boosttime = opt_boost;
+  if((workload_count() > 0) && (workload_seek(workload_first()) < 0)){
+    return -1;
+  }
+
+  if(opt_pool && (pool_start() < 0)){
+    return -1;
+  }
 
   return 0;
 }
@@ -324,149 +1120,578 @@ static int num_procs_exited(){
   return proc_exited[0] + proc_exited[1];
 }
 
-/* Do a time jump to next time a process starts */
+/* Do a time jump to next event - process start, burst end or unblock */
 static int scheduler_tjump(){
-  struct timeval tv, idle_from = simulator_obj->clock;
+  simtime_t tv;
+  const simtime_t idle_from = simulator_obj->clock;
   const struct qitem * item = bq_top();
+  const simtime_t * next = NULL;
+  const char * what = NULL;
+  unsigned int c;
+  int busy = 0;
+
+  /* if we can start another process. A workload job waits for a free
+     control block, instead of being skipped */
+  if( (proc_started < simulator_obj->cfg.proc_total) &&
+      ((workload_count() == 0) || (proc_started - num_procs_exited() < simulator_obj->cfg.proc_limit))){
+    next = &forktime;
+    what = "fork";
+  }
 
-  /* if we can start another process */
-  if(num_procs_exited() < PROC_TOTAL){
-    
-    if(timercmp(&simulator_obj->clock, &forktime, <)){
-      /* advance to next fork time */
-      simulator_obj->clock = forktime;
-      ln_check(); printf("OSS: Jumped to next fork time %li:%li\n", simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+  /* earliest burst end */
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    if(cores[c].id == -1){
+      continue;
     }
+    busy++;
+    if((next == NULL) || (cores[c].clock < *next)){
+      next = &cores[c].clock;
+      what = "burst end";
+    }
+  }
+
+  /* if we have blocked users, with an earlier event and a core to run them,
+     or a ready queue to wait in */
+  if(item && ((busy < simulator_obj->cfg.cores) || (simulator_obj->cfg.engine != RQ_FIFO)) &&
+     ((next == NULL) || (item->tv < *next))){
+    next = &item->tv;
+    what = "event";
+  }
 
-  /* if we have blocked users */
-  }else if(item){
+  if(next == NULL){
+    /* nobody to fork/unblock, wait for running users to exit */
+    return (num_procs_exited() < simulator_obj->cfg.proc_total) ? 0 : -1;
+  }
+
+  if(simulator_obj->clock < *next){
+    /* advance to next event time */
+    simulator_obj->clock = *next;
+    log_msg(LOG_DEBUG, "OSS: Jumped to next %s time " TIME_FMT "\n", what, TIME_ARG(simulator_obj->clock));
+  }
 
-    if(timercmp(&simulator_obj->clock, &item->tv, <)){
-      /* move to next unblock time */
-      simulator_obj->clock = item->tv;
-      ln_check(); printf("OSS: Jumped to next event time %li:%li\n", simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+  /* update idle time, when all cores were free */
+  tv = simulator_obj->clock - idle_from;
+  stat_rq_area += (double) rq_size() * tv;
+  if(!busy && (tv > 0)){
+    stat_time[ST_IDLE] += tv;
+    trace_add(TR_IDLE, -1, idle_from, tv);
+    log_msg(LOG_DEBUG, "OSS: idled for " TIME_FMT " at " TIME_FMT "\n",
+      TIME_ARG(tv), TIME_ARG(simulator_obj->clock));
+  }
+
+  /* finish bursts that ended */
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    if((cores[c].id != -1) && (cores[c].clock <= simulator_obj->clock)){
+      const simtime_t t = dispatch_time();
+      core_complete(c);
+      if(opt_mode != MODE_DES){
+        hist_add(&stat_phase[PH_ACCOUNT], wall_time() - t);
+      }
     }
+  }
 
-  /*nobody to fork/unblock */
-  }else{
+  return 0;
+}
+
+/* Checkpoint file - header, then state in the order of ckpt_sections() */
+#define CKPT_MAGIC "OSSCKPT"
+#define CKPT_VERSION 3
+
+struct ckpt_header {
+  char magic[8];
+  uint32_t version;
+  /* layouts that are saved as they are in memory */
+  uint32_t proc_size, core_size, prefetch_size, hist_size;
+  struct simulator_config cfg;
+  /* oss options, that change the run, but are not in config */
+  uint64_t boost;       /* -b */
+  uint32_t pipeline;    /* -P */
+  uint32_t reserved;
+};
+
+/* piece of state, saved as it is in memory */
+struct ckpt_section {
+  void * ptr;
+  size_t size;
+};
+
+static FILE * ckpt_restore = NULL;  /* -r, open until state is loaded */
+
+/* Sections of checkpoint, after the header. Returns their count */
+static int ckpt_sections(struct ckpt_section * s){
+  int n = 0;
+  s[n++] = (struct ckpt_section) {&simulator_obj->clock, sizeof(simulator_obj->clock)};
+  s[n++] = (struct ckpt_section) {&forktime, sizeof(forktime)};
+  s[n++] = (struct ckpt_section) {&wl_next, sizeof(wl_next)};
+  s[n++] = (struct ckpt_section) {&boosttime, sizeof(boosttime)};
+  s[n++] = (struct ckpt_section) {&thread_pid, sizeof(thread_pid)};
+  s[n++] = (struct ckpt_section) {&proc_started, sizeof(proc_started)};
+  s[n++] = (struct ckpt_section) {proc_exited, sizeof(proc_exited)};
+  s[n++] = (struct ckpt_section) {stat_time, sizeof(stat_time)};
+  s[n++] = (struct ckpt_section) {&stat_bursts, sizeof(stat_bursts)};
+  s[n++] = (struct ckpt_section) {&stat_rtt, sizeof(stat_rtt)};
+  s[n++] = (struct ckpt_section) {&stat_rq_area, sizeof(stat_rq_area)};
+  s[n++] = (struct ckpt_section) {stat_proc, sizeof(stat_proc)};
+  s[n++] = (struct ckpt_section) {oss_rng, sizeof(oss_rng)};
+  s[n++] = (struct ckpt_section) {&prefetch_len, sizeof(prefetch_len)};
+  s[n++] = (struct ckpt_section) {simulator_obj->procs, sizeof(struct proc) * simulator_obj->cfg.proc_limit};
+  s[n++] = (struct ckpt_section) {cores, sizeof(struct core) * simulator_obj->cfg.cores};
+  s[n++] = (struct ckpt_section) {prefetch, sizeof(struct prefetch) * simulator_obj->cfg.proc_limit};
+  return n;
+}
+
+static void ckpt_header_init(struct ckpt_header * hdr){
+  bzero(hdr, sizeof(struct ckpt_header));
+  memcpy(hdr->magic, CKPT_MAGIC, sizeof(hdr->magic));
+  hdr->version = CKPT_VERSION;
+  hdr->proc_size = sizeof(struct proc);
+  hdr->core_size = sizeof(struct core);
+  hdr->prefetch_size = sizeof(struct prefetch);
+  hdr->hist_size = sizeof(struct hist);
+  hdr->cfg = simulator_obj->cfg;
+  hdr->boost = opt_boost;
+  hdr->pipeline = opt_pipeline;
+}
+
+/* Wait for replies to slices sent ahead, so no message is in flight */
+static int prefetch_drain(){
+  struct msgbuf buf;
+  unsigned int i;
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    while(prefetch[i].state == PF_SENT){
+      buf.mtype = TYPE_BURSTED;
+      buf.id = i;
+      if(msg_recv(&buf) == -1){
+        perror(perror_buf);
+        return -1;
+      }
+      /* message queue replies come in any order */
+      if((buf.id >= 0) && (buf.id < simulator_obj->cfg.proc_limit) && (prefetch[buf.id].state == PF_SENT)){
+        prefetch[buf.id].state = PF_DONE;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Save scheduler state between two steps, when every core has its user decision */
+static int checkpoint_save(const char * path){
+  struct ckpt_section s[32];
+  struct ckpt_header hdr;
+  char tmp[PATH_MAX];
+  unsigned int i;
+  int n, rv = 0;
+
+  if((opt_mode != MODE_DES) && (prefetch_drain() < 0)){
+    return -1;
+  }
+
+  /* write next to it, so an old checkpoint is replaced only by a complete one */
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE * fp = fopen(tmp, "w");
+  if(fp == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  ckpt_header_init(&hdr);
+  if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1){
+    rv = -1;
+  }
+
+  const int count = ckpt_sections(s);
+  for(n=0; (rv == 0) && (n < count); n++){
+    if(fwrite(s[n].ptr, s[n].size, 1, fp) != 1){
+      rv = -1;
+    }
+  }
+
+  /* used control blocks */
+  for(i=0; (rv == 0) && (i < simulator_obj->cfg.proc_limit); i++){
+    const unsigned char live = bit_test(i) ? 1 : 0;
+    if(fwrite(&live, 1, 1, fp) != 1){
+      rv = -1;
+    }
+  }
+
+  if((rv == 0) && (queues_save(fp) < 0)){
+    rv = -1;
+  }
+
+  if((fclose(fp) == EOF) || (rv < 0) || (rename(tmp, path) == -1)){
+    perror(perror_buf);
+    unlink(tmp);
+    return -1;
+  }
+
+  log_msg(LOG_ALWAYS, "OSS: Checkpoint saved to %s at time " TIME_FMT "\n", path, TIME_ARG(simulator_obj->clock));
+  return 0;
+}
+
+/* Open checkpoint and take simulation parameters from it. How
+   users talk to oss stays as on command line */
+static int checkpoint_open(const char * path){
+  struct ckpt_header hdr;
+
+  ckpt_restore = fopen(path, "r");
+  if(ckpt_restore == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  if( (fread(&hdr, sizeof(hdr), 1, ckpt_restore) != 1) ||
+      (memcmp(hdr.magic, CKPT_MAGIC, sizeof(hdr.magic)) != 0) ||
+      (hdr.version != CKPT_VERSION)){
+    fprintf(stderr, "%s%s is not a checkpoint of version %d\n", perror_buf, path, CKPT_VERSION);
+    return -1;
+  }
+  if( (hdr.proc_size != sizeof(struct proc)) || (hdr.core_size != sizeof(struct core)) ||
+      (hdr.prefetch_size != sizeof(struct prefetch)) || (hdr.hist_size != sizeof(struct hist))){
+    fprintf(stderr, "%s%s was saved by a different build of oss\n", perror_buf, path);
+    return -1;
+  }
+
+  hdr.cfg.transport = opt_cfg.transport;
+  hdr.cfg.msg_spin  = opt_cfg.msg_spin;
+  opt_cfg = hdr.cfg;
+  opt_seeded = 1;
+  opt_boost = hdr.boost;
+  opt_pipeline = hdr.pipeline;
+  return 0;
+}
+
+/* Save checkpoint to -C file. A failed save is logged, so the
+   run doesn't end as if it was saved */
+static int checkpoint_take(){
+  if(checkpoint_save(opt_checkpoint) < 0){
+    log_msg(LOG_ALWAYS, "OSS: Checkpoint to %s failed at time " TIME_FMT "\n", opt_checkpoint, TIME_ARG(simulator_obj->clock));
     return -1;
   }
+  return 0;
+}
+
+/* Load state after the header, and start users for the live control blocks.
+   Users continue from random streams in their control blocks */
+static int checkpoint_load(){
+  struct ckpt_section s[32];
+  unsigned char live;
+  unsigned int i;
+  int n;
+
+  const int count = ckpt_sections(s);
+  for(n=0; n < count; n++){
+    if(fread(s[n].ptr, s[n].size, 1, ckpt_restore) != 1){
+      fprintf(stderr, "%sCheckpoint is truncated\n", perror_buf);
+      return -1;
+    }
+  }
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    if(fread(&live, 1, 1, ckpt_restore) != 1){
+      fprintf(stderr, "%sCheckpoint is truncated\n", perror_buf);
+      return -1;
+    }
+    if(live){
+      bv_on(i);
+    }
+  }
+
+  if(queues_load(ckpt_restore) < 0){
+    fprintf(stderr, "%sCheckpoint is truncated\n", perror_buf);
+    return -1;
+  }
+  fclose(ckpt_restore);
+  ckpt_restore = NULL;
+
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    if(!bit_test(i)){
+      continue;
+    }
+    struct proc * proc = &simulator_obj->procs[i];
+    const int c = core_find(i);
+
+    /* user has decided to terminate, so it has no user to run */
+    const int term = ((c != -1) && (cores[c].action == ACT_TERM)) ||
+                     ((prefetch[i].state == PF_DONE) && (proc->action == ACT_TERM));
+
+    pid_t pid = proc->pid;
+    if(term && (opt_mode != MODE_DES)){
+      pid = thread_pid++;
+      if(c != -1){
+        cores[c].reaped = 1;
+      }else{
+        prefetch[i].reaped = 1;
+      }
+    }else if(opt_mode == MODE_THREAD){
+      pid = user_thread_start(i);
+    }else if(opt_mode == MODE_PROC){
+      pid = (opt_pool) ? pool_bind(i) : user_fork(i);
+    }
+    if(pid == -1){
+      return -1;
+    }
 
-  /* update idle time */
-  timersub(&simulator_obj->clock, &idle_from, &tv);
-  tincrement(&stat_time[ST_IDLE], &tv);
-  if(timerisset(&tv)){
-    ln_check(); printf("OSS: idled for %li:%li at %li:%li\n",
-      tv.tv_sec, tv.tv_usec,
-      simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+    proc->pid = pid;
+    pid_index_add(pid, i);
+    if(c != -1){
+      cores[c].pid = pid;
+    }
   }
 
+  log_msg(LOG_ALWAYS, "OSS: Restored %d processes at time " TIME_FMT "\n",
+    proc_started - num_procs_exited(), TIME_ARG(simulator_obj->clock));
   return 0;
 }
 
-static void scheduler_tadvance(){
-  //advance time
-  struct timeval tv, temp = simulator_obj->clock;
-  tv.tv_sec += rand() % 2;
-  tv.tv_usec += rand() % 1000;
-  timeradd(&temp, &tv, &simulator_obj->clock);
-  ln_check(); printf("OSS: Advanced time to %li:%li\n", simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+/* Copy counters to live stats segment */
+static void stats_publish(){
+  unsigned int i, running = 0;
+
+  for(i=0; i < simulator_obj->cfg.cores; i++){
+    running += (cores[i].id != -1);
+  }
+
+  stats_write_begin(live_stats);
+  live_stats->wall_ns = wall_time();
+  live_stats->clock = simulator_obj->clock;
+  live_stats->started = proc_started;
+  live_stats->exited = num_procs_exited();
+  live_stats->dispatches = stat_bursts;
+  live_stats->idle = stat_time[ST_IDLE];
+  live_stats->blocked = bq_length();
+  live_stats->running = running;
+  for(i=0; i < simulator_obj->cfg.rq_count; i++){
+    live_stats->rq_len[i] = rq_length(i);
+  }
+  stats_write_end(live_stats);
 }
 
 static int scheduler_run(){
 
   /* while we have procs running */
-  while(!is_signalled){
+  while(!stop_requested){
 
-    //if its time to start a process
-    if(timercmp(&simulator_obj->clock, &forktime, >=)){
+    /* signals, timer and live stats are checked every few loops */
+    const int periodic = ((++event_loops % EVENT_POLL_LOOPS) == 0);
+
+    /* forked users must be reaped to free their control blocks, so poll
+       each time. Otherwise only signals and timer are waited for */
+    if(((opt_mode == MODE_PROC) && !opt_pool) || periodic){
+      events_poll(0);
+    }
+
+    if(checkpoint_requested){
+      checkpoint_requested = 0;
+      checkpoint_take();
+    }
+
+    if(opt_mode == MODE_THREAD){
+      do_join(0);
+    }
 
-      //generate random time, after which a new process will be started
-      struct timeval tv;
-      tv.tv_sec  = rand() % maxTimeBetweenNewProcsSecs;
-      tv.tv_usec = rand() % maxTimeBetweenNewProcsNS;
+    /* periodic boost of feedback queue priorities */
+    if((simulator_obj->cfg.engine == RQ_MLFQ) && (opt_boost > 0) && (simulator_obj->clock >= boosttime)){
+      rq_boost();
+      boosttime = ((simulator_obj->clock / opt_boost) + 1) * opt_boost;
+    }
 
-      tincrement(&forktime, &tv);
+    //if its time to start a process
+    if(simulator_obj->clock >= forktime){
+
+      if(workload_count() == 0){
+        //generate random time, after which a new process will be started
+        forktime += rng_below(&oss_rng[RNG_ARRIVAL], maxTimeBetweenNewProcsSecs) * NS_PER_SEC;
+        forktime += rng_below(&oss_rng[RNG_ARRIVAL], maxTimeBetweenNewProcsNS);
+      }
 
       /* check if we can run another user */
       const int num_running = proc_started - num_procs_exited();
-      if( (num_running < PROC_LIMIT) &&
-          (proc_started < PROC_TOTAL) ){
+      if( (num_running < simulator_obj->cfg.proc_limit) &&
+          (proc_started < simulator_obj->cfg.proc_total) ){
 
-        /* avoid signals, while we fork and fill proc details */
-        block_signals();
         const int rv = docommand();
-        unblock_signals();
 
         if(rv == -1){
           break;
         }else if(rv == 1){
           ++proc_started;
+          if((workload_count() > 0) && (workload_seek(workload_next(wl_next)) < 0)){
+            break;
+          }
         }
       }
     }
 
-    block_signals();
-    const int nq = scheduler_wakeup();
-    unblock_signals();
+    /* run users on free cores, then jump to next event */
+    int rv = scheduler_wakeup();
+    if(rv == 0){
+      rv = scheduler_tjump();
+    }
 
-    if(nq == 0){
-      /* jump to next fork/unblock time */
-      if(scheduler_tjump() < 0){
-        break;
-      }
-    }else{
-      /* just update time */
-      scheduler_tadvance();
+    /* ossstat reads them about once a second, and they are published again at exit */
+    if(periodic){
+      stats_publish();
     }
 
-    //sleep(2);
+    if(rv < 0){
+      break;
+    }
   }
 
   return 0;
 }
 
+/* Free the cores when simulation stops, bursts in flight are dropped */
+static void scheduler_stop(){
+  unsigned int c;
+
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    const int id = cores[c].id;
+    cores[c].id = -1;
+    if((id != -1) && cores[c].reaped){
+      proc_onexit(id);
+    }
+  }
+
+  /* and slices sent ahead are dropped */
+  for(c=0; c < simulator_obj->cfg.proc_limit; c++){
+    const int reaped = prefetch[c].reaped;
+    bzero(&prefetch[c], sizeof(struct prefetch));
+    if(reaped){
+      proc_onexit(c);
+    }
+  }
+  prefetch_len = 0;
+}
+
 static void stat_scheduler(){
 
-  taverage(&stat_time[ST_WAIT], proc_started);
-  taverage(&stat_time[ST_EXEC], proc_started);
-  taverage(&stat_time[ST_BLOCK0], proc_exited[0]);
-  taverage(&stat_time[ST_BLOCK1], proc_exited[1]);
+  /* times are summed when process exits, so average over exited ones */
+  const int exited = num_procs_exited();
 
-  /* make sure we save stat to log file, even if its after MAX_LINES */
-  stdout = freopen(opt_log, "a", stdout);
+  log_msg(LOG_ALWAYS, "Average process exec time: " TIME_FMT "\n", TIME_ARG(taverage(stat_time[ST_EXEC], exited)));
+  log_msg(LOG_ALWAYS, "Average ready wait time: " TIME_FMT "\n", TIME_ARG(taverage(stat_time[ST_WAIT], exited)));
 
-  printf("Average process exec time: %li:%li\n", stat_time[ST_EXEC].tv_sec, stat_time[ST_EXEC].tv_usec);
-  printf("Average ready wait time: %li:%li\n", stat_time[ST_WAIT].tv_sec, stat_time[ST_WAIT].tv_usec);
+  log_msg(LOG_ALWAYS, "Average CPU bound blocked : " TIME_FMT "\n", TIME_ARG(taverage(stat_time[ST_BLOCK0], proc_exited[B_CPU])));
+  log_msg(LOG_ALWAYS, "Average IO  bound blocked : " TIME_FMT "\n", TIME_ARG(taverage(stat_time[ST_BLOCK1], proc_exited[B_IO])));
 
-  printf("Average CPU bound blocked : %li:%li\n", stat_time[ST_BLOCK0].tv_sec, stat_time[ST_BLOCK0].tv_usec);
-  printf("Average IO  bound blocked : %li:%li\n", stat_time[ST_BLOCK1].tv_sec, stat_time[ST_BLOCK1].tv_usec);
+  log_msg(LOG_ALWAYS, "All CPUs idled for : " TIME_FMT "\n", TIME_ARG(stat_time[ST_IDLE]));
 
-  printf("CPU idled for : %li:%li\n", stat_time[ST_IDLE].tv_sec, stat_time[ST_IDLE].tv_usec);
-  const float cpu_util = (float) stat_time[ST_IDLE].tv_sec / (float)simulator_obj->clock.tv_sec;
-  printf("CPU utilization: %.2f%%\n", 100.0f - (cpu_util * 100.0f));
+  /* core is utilized while it dispatches or runs a user */
+  simtime_t busy = 0;
+  unsigned int c;
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    busy += cores[c].busy;
+    log_msg(LOG_ALWAYS, "CPU %u utilization: %.2f%%\n", c, (simulator_obj->clock == 0) ? 0.0 :
+      100.0 * (double) cores[c].busy / (double) simulator_obj->clock);
+  }
+  log_msg(LOG_ALWAYS, "CPU utilization: %.2f%%\n", (simulator_obj->clock == 0) ? 0.0 :
+    100.0 * (double) busy / ((double) simulator_obj->clock * simulator_obj->cfg.cores));
+  log_msg(LOG_ALWAYS, "Average ready queue length: %.2f\n", (simulator_obj->clock == 0) ? 0.0 :
+    stat_rq_area / (double) simulator_obj->clock);
+
+  /* process distributions, times in seconds */
+  static const char * bound_name[B_COUNT] = {"CPU", "IO "};
+  enum proc_bound b;
+  enum proc_stat ps;
+  for(b=0; b < B_COUNT; b++){
+    for(ps=0; ps < PS_COUNT; ps++){
+      const struct hist * h = &stat_proc[b][ps];
+      const double unit = (ps == PS_SWITCHES) ? 1.0 : (double) NS_PER_SEC;
+      log_msg(LOG_ALWAYS, "%s bound %-10s: count=%lu mean=%.3f sd=%.3f p50=%.3f p90=%.3f p99=%.3f p99.9=%.3f max=%.3f\n",
+        bound_name[b], proc_stat_name[ps], h->count, hist_mean(h) / unit, hist_stddev(h) / unit,
+        hist_quantile(h, 0.5) / unit, hist_quantile(h, 0.9) / unit, hist_quantile(h, 0.99) / unit,
+        hist_quantile(h, 0.999) / unit, h->max / unit);
+    }
+  }
+  log_msg(LOG_ALWAYS, "Log records dropped: %lu\n", log_dropped());
+
+  /* dispatch phases in wall time */
+  enum stat_phase ph;
+  for(ph=0; ph < PH_COUNT; ph++){
+    const struct hist * h = &stat_phase[ph];
+    log_msg(LOG_ALWAYS, "Dispatch %-7s ns: count=%lu p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu\n",
+      phase_name[ph], h->count, hist_quantile(h, 0.5), hist_quantile(h, 0.9),
+      hist_quantile(h, 0.99), hist_quantile(h, 0.999), h->max);
+  }
 }
 
-int main(const int argc, char * const argv[]){
-  struct sigaction sa;
+/* Peak resident size in KB. ru_maxrss is kept over exec, so
+   it can be of our parent. VmHWM starts over with our program */
+static long peak_rss(){
+  struct rusage ru;
+  char line[128];
+  long kb = -1;
+
+  FILE * fp = fopen("/proc/self/status", "r");
+  if(fp){
+    while(fgets(line, sizeof(line), fp)){
+      if(sscanf(line, "VmHWM: %ld", &kb) == 1){
+        break;
+      }
+    }
+    fclose(fp);
+  }
 
-  sa.sa_flags = 0;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_handler = on_interrupt;
-  if( (sigaction(SIGINT, &sa, NULL) == -1) ||
-      (sigaction(SIGTERM, &sa, NULL) == -1) ||
-      (sigaction(SIGCHLD, &sa, NULL) == -1) ||
-      (sigaction(SIGALRM, &sa, NULL) == -1)){
-     perror("sigaction");
-     return EXIT_FAILURE;
+  if(kb == -1){
+    getrusage(RUSAGE_SELF, &ru);
+    kb = ru.ru_maxrss;
   }
+  return kb;
+}
+
+/* Save run summary, for comparing runs on same host */
+static int stat_json(const char * path){
+  static const char * modes[] = {"proc", "thread", "des"};
+  static const char * engines[] = {"fifo", "cfs", "mlfq"};
 
-  sa.sa_handler = SIG_IGN;
-  if(sigaction(SIGTERM, &sa, NULL) == -1){
-     perror("sigaction");
-     return EXIT_FAILURE;
+  FILE * fp = fopen(path, "w");
+  if(fp == NULL){
+    perror(perror_buf);
+    return -1;
   }
 
+  const double wall = (wall_end.tv_sec - wall_start.tv_sec) + ((wall_end.tv_nsec - wall_start.tv_nsec) / 1e9);
+
+  const int exited = num_procs_exited();
+  simtime_t busy = 0;
+  unsigned int c;
+  for(c=0; c < simulator_obj->cfg.cores; c++){
+    busy += cores[c].busy;
+  }
+
+  fprintf(fp, "{\"mode\":\"%s\",\"engine\":\"%s\",\"transport\":\"%s\",\"proc_limit\":%u,\"proc_total\":%u,\"cores\":%u,\"pipeline\":%u,"
+              "\"slice_ns\":%u,\"int_cpu\":%u,\"int_io\":%u,"
+              "\"seed\":%llu,\"started\":%d,\"exited\":%d,\"bursts\":%lu,\"wall_s\":%.6f,\"bursts_per_s\":%.1f,"
+              "\"dispatch_rtt_ns\":%.1f,\"reply_p50_ns\":%lu,\"reply_p99_ns\":%lu,\"sim_time_ns\":%llu,"
+              "\"avg_exec_ns\":%lu,\"avg_wait_ns\":%lu,\"avg_block_cpu_ns\":%lu,\"avg_block_io_ns\":%lu,"
+              "\"idle_ns\":%lu,\"cpu_util\":%.4f,\"avg_rq_len\":%.3f,"
+              "\"turnaround_p99_ns_cpu\":%lu,\"turnaround_p99_ns_io\":%lu,\"response_p99_ns_cpu\":%lu,\"response_p99_ns_io\":%lu,"
+              "\"peak_rss_kb\":%ld}\n",
+    modes[opt_mode], engines[simulator_obj->cfg.engine],
+    (simulator_obj->cfg.transport == MSG_RING) ? "ring" : "sysv",
+    simulator_obj->cfg.proc_limit, simulator_obj->cfg.proc_total, simulator_obj->cfg.cores, opt_pipeline,
+    simulator_obj->cfg.slice_ns, simulator_obj->cfg.int_prob[B_CPU], simulator_obj->cfg.int_prob[B_IO],
+    (unsigned long long) simulator_obj->cfg.seed, proc_started, exited, stat_bursts,
+    wall, (wall > 0) ? stat_bursts / wall : 0.0,
+    (stat_bursts > 0) ? (double) stat_rtt / stat_bursts : 0.0,
+    hist_quantile(&stat_phase[PH_REPLY], 0.5), hist_quantile(&stat_phase[PH_REPLY], 0.99),
+    (unsigned long long) simulator_obj->clock,
+    taverage(stat_time[ST_EXEC], exited), taverage(stat_time[ST_WAIT], exited),
+    taverage(stat_time[ST_BLOCK0], proc_exited[B_CPU]), taverage(stat_time[ST_BLOCK1], proc_exited[B_IO]),
+    stat_time[ST_IDLE], (simulator_obj->clock == 0) ? 0.0 : (double) busy / ((double) simulator_obj->clock * simulator_obj->cfg.cores),
+    (simulator_obj->clock == 0) ? 0.0 : stat_rq_area / (double) simulator_obj->clock,
+    hist_quantile(&stat_proc[B_CPU][PS_TURNAROUND], 0.99), hist_quantile(&stat_proc[B_IO][PS_TURNAROUND], 0.99),
+    hist_quantile(&stat_proc[B_CPU][PS_RESPONSE], 0.99), hist_quantile(&stat_proc[B_IO][PS_RESPONSE], 0.99),
+    peak_rss());
+
+  fclose(fp);
+  return 0;
+}
+
+int main(const int argc, char * const argv[]){
+
   if(check_arguments(argc, argv) < 0){
     return EXIT_FAILURE;
   }
@@ -474,26 +1699,133 @@ int main(const int argc, char * const argv[]){
   /* create the error string from program name */
   snprintf(perror_buf, sizeof(perror_buf), "%s: Error: ", argv[0]);
 
+  if(events_init() < 0){
+    return EXIT_FAILURE;
+  }
+
+  if(opt_restore && (checkpoint_open(opt_restore) < 0)){
+    return EXIT_FAILURE;
+  }
+
+  if(opt_cfg.workload[0]){
+    if(workload_open(opt_cfg.workload) < 0){
+      return EXIT_FAILURE;
+    }
+    /* whole workload is replayed, unless -t limits it. A checkpoint has it limited already */
+    if((!opt_total_set && !opt_restore) || (opt_cfg.proc_total > workload_count())){
+      opt_cfg.proc_total = workload_count();
+    }
+  }
+
+  if(log_open(opt_log, opt_log_size, opt_log_level) < 0){
+    return EXIT_FAILURE;
+  }
+
+  if(opt_trace && (trace_open(opt_trace, opt_cfg.proc_limit, opt_cfg.cores) < 0)){
+    return EXIT_FAILURE;
+  }
+
   /* create the license object */
-  if(create_simulator(1) < 0){
+  simulator_instance(opt_instance);
+  if(opt_mode == MODE_DES){
+    /* nobody attaches to it, so keep it in our memory */
+    if(create_local_simulator(opt_cfg.proc_limit) < 0){
+      return EXIT_FAILURE;
+    }
+    simulator_obj->cfg = opt_cfg;
+  }else{
+    if(create_simulator(opt_cfg.proc_limit) < 0){
+      return EXIT_FAILURE;
+    }
+    simulator_obj->cfg = opt_cfg;
+    msg_init();
+  }
+
+  live_stats = stats_create();
+  if(live_stats == NULL){
     return EXIT_FAILURE;
   }
+  live_stats->rq_count = opt_cfg.rq_count;
+  live_stats->cores = opt_cfg.cores;
 
   if(scheduler_init() < 0){
     return EXIT_FAILURE;
   }
 
+  if(opt_restore && (checkpoint_load() < 0)){
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
   scheduler_run();
+  /* stopped by signal or time limit, save where we are */
+  int status = EXIT_SUCCESS;
+  if(stop_requested && opt_checkpoint && (checkpoint_take() < 0)){
+    status = EXIT_FAILURE;
+  }
+  scheduler_stop();
 
   /* wait for any processes left */
-  while(num_procs_exited() < proc_started){
-    do_wait(0);
+  if(opt_mode == MODE_THREAD){
+    users_stop();
+    while(num_procs_exited() < proc_started){
+      do_join(1);
+    }
+  }else if(opt_mode == MODE_DES){
+    /* simulated processes just end with the run */
+    unsigned int i;
+    for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+      if(bit_test(i)){
+        proc_onexit(i);
+      }
+    }
+  }else if(opt_pool){
+    pool_stop();
+    while(workers_alive > 0){
+      do_wait(0);
+    }
+  }else{
+    users_stop();
+    while(num_procs_exited() < proc_started){
+      do_wait(0);
+    }
   }
 
-  printf("OSS: master terminated at %li:%li.\n", simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  stats_publish();
+
+  log_msg(LOG_ALWAYS, "OSS: master terminated at " TIME_FMT ".\n", TIME_ARG(simulator_obj->clock));
   stat_scheduler();
+  if(opt_json){
+    stat_json(opt_json);
+  }
 
-  destroy_simulator(1);
+  if(opt_mode == MODE_THREAD){
+    pthread_attr_destroy(&user_attr);
+    free(user_threads);
+    free(user_done);
+  }
+  pid_index_free();
+  bv_free();
+  queues_deinit();
+  free(cores);
+  free(prefetch);
+  free(workers);
+  if(opt_mode == MODE_DES){
+    destroy_local_simulator();
+  }else{
+    destroy_simulator(opt_cfg.proc_limit);
+  }
+
+  stats_destroy(live_stats);
+  trace_close();
+  workload_close();
+  events_close();
+
+  if(log_dropped() > 0){
+    fprintf(stderr, "OSS: %lu log records were dropped\n", log_dropped());
+  }
+  log_close();
 
-  return EXIT_SUCCESS;
+  return status;
 }
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "common.h"
+#include "queue.h"
+#include "bv.h"
+#include "log.h"
+
+/* Benchmarks of oss data structures, and of whole oss runs.
+   Each result is printed as one JSON object per line */
+
+/* table sizes for micro benchmarks */
+static const unsigned int sizes[] = {18, 1024, 65536};
+#define SIZE_COUNT (sizeof(sizes) / sizeof(sizes[0]))
+
+/* operations per micro benchmark */
+#define BENCH_OPS 2000000
+
+static uint64_t now_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+/* small generator, so we don't time rng.c */
+static uint64_t bench_state = 88172645463325252ULL;
+static unsigned int bench_rand(){
+  bench_state ^= bench_state << 13;
+  bench_state ^= bench_state >> 7;
+  bench_state ^= bench_state << 17;
+  return (unsigned int) bench_state;
+}
+
+static void report(const char * name, const char * variant, const unsigned int n, const unsigned long ops, const uint64_t ns){
+  printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"n\":%u,\"ops\":%lu,\"ns_per_op\":%.2f}\n",
+    name, variant, n, ops, (double) ns / ops);
+  fflush(stdout);
+}
+
+static int sim_init(const unsigned int n, const enum rq_engine engine){
+  if(create_local_simulator(n) < 0){
+    return -1;
+  }
+  simulator_obj->cfg.proc_total = n;
+  simulator_obj->cfg.slice_ns = SLICE_NS;
+  simulator_obj->cfg.rq_count = (engine == RQ_MLFQ) ? 8 : RQ_COUNT;
+  simulator_obj->cfg.cores = 1;
+  simulator_obj->cfg.engine = engine;
+  return 0;
+}
+
+/* allocate and release control blocks, with the table nearly full */
+static int bench_bv(const unsigned int n){
+  unsigned long i;
+
+  if(bv_init(n) < 0){
+    return -1;
+  }
+  for(i=0; i < n; i++){
+    bv_on(bv_index());
+  }
+
+  const uint64_t t0 = now_ns();
+  for(i=0; i < BENCH_OPS; i++){
+    const int id = bench_rand() % n;
+    bv_off(id);
+    bv_on(bv_index());
+  }
+  report("bv", "free_alloc", n, BENCH_OPS, now_ns() - t0);
+
+  bv_free();
+  return 0;
+}
+
+/* ready queue with all processes in it, pop the next and push it back */
+static int bench_rq(const unsigned int n, const enum rq_engine engine, const char * variant){
+  unsigned long i;
+
+  if((sim_init(n, engine) < 0) || (queues_init() < 0)){
+    return -1;
+  }
+  for(i=0; i < n; i++){
+    struct proc * proc = &simulator_obj->procs[i];
+    proc->id = i;
+    proc->bound = bench_rand() % B_COUNT;
+    queues_proc_init(proc);
+    rq_push(i);
+  }
+
+  const uint64_t t0 = now_ns();
+  for(i=0; i < BENCH_OPS; i++){
+    const int id = rq_pop();
+    rq_account(id, bench_rand() % SLICE_NS, (bench_rand() & 1) ? ACT_EXEC : ACT_INT);
+    simulator_obj->clock += 1000;
+    rq_push(id);
+  }
+  report("rq_pop_push", variant, n, BENCH_OPS, now_ns() - t0);
+
+  queues_deinit();
+  destroy_local_simulator();
+  return 0;
+}
+
+/* blocked queue with all processes in it, unblock earliest and block it again */
+static int bench_bq(const unsigned int n){
+  unsigned long i;
+
+  if((sim_init(n, RQ_FIFO) < 0) || (queues_init() < 0)){
+    return -1;
+  }
+  for(i=0; i < n; i++){
+    simulator_obj->procs[i].id = i;
+    queues_proc_init(&simulator_obj->procs[i]);
+    bq_push(i, bench_rand() % NS_PER_SEC);
+  }
+
+  const uint64_t t0 = now_ns();
+  for(i=0; i < BENCH_OPS; i++){
+    simulator_obj->clock = bq_top()->tv;
+    const int id = bq_pop();
+    bq_push(id, simulator_obj->clock + (bench_rand() % NS_PER_SEC));
+  }
+  report("bq_pop_push", "heap", n, BENCH_OPS, now_ns() - t0);
+
+  queues_deinit();
+  destroy_local_simulator();
+  return 0;
+}
+
+/* look up random live pids */
+static int bench_find(const unsigned int n){
+  unsigned long i;
+  unsigned long found = 0;
+
+  if((sim_init(n, RQ_FIFO) < 0) || (pid_index_init(n) < 0)){
+    return -1;
+  }
+  for(i=0; i < n; i++){
+    /* pids like the kernel gives them, mostly increasing */
+    simulator_obj->procs[i].pid = 1000 + (i * 3) + (bench_rand() % 3);
+    pid_index_add(simulator_obj->procs[i].pid, i);
+  }
+
+  const uint64_t t0 = now_ns();
+  for(i=0; i < BENCH_OPS; i++){
+    found += (find_proc(simulator_obj->procs[bench_rand() % n].pid) != NULL);
+  }
+  report("find_proc", "hash", n, BENCH_OPS, now_ns() - t0);
+
+  if(found != BENCH_OPS){
+    fprintf(stderr, "ossbench: find_proc missed %lu pids\n", BENCH_OPS - found);
+  }
+
+  pid_index_free();
+  destroy_local_simulator();
+  return 0;
+}
+
+/* Run oss with arguments, and print its summary */
+static int bench_oss(const char * name, char * const args[]){
+  char json[64], line[1024];
+  char * argv[32];
+  int argc = 0, status;
+
+  snprintf(json, sizeof(json), "/tmp/ossbench.%d.json", getpid());
+
+  argv[argc++] = "./oss";
+  while(*args){
+    argv[argc++] = *args++;
+  }
+  argv[argc++] = "-l";
+  argv[argc++] = "/dev/null";
+  argv[argc++] = "-z";
+  argv[argc++] = "0";
+  argv[argc++] = "-v";
+  argv[argc++] = "4";
+  argv[argc++] = "-S";
+  argv[argc++] = "1";
+  argv[argc++] = "-j";
+  argv[argc++] = json;
+  argv[argc] = NULL;
+
+  const pid_t pid = fork();
+  if(pid == -1){
+    perror("fork");
+    return -1;
+  }else if(pid == 0){
+    execv(argv[0], argv);
+    perror(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if((waitpid(pid, &status, 0) == -1) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)){
+    fprintf(stderr, "ossbench: %s failed\n", name);
+    return -1;
+  }
+
+  FILE * fp = fopen(json, "r");
+  if((fp == NULL) || (fgets(line, sizeof(line), fp) == NULL)){
+    perror(json);
+    return -1;
+  }
+  fclose(fp);
+  unlink(json);
+
+  line[strcspn(line, "\n")] = '\0';
+  printf("{\"bench\":\"oss\",\"variant\":\"%s\",\"result\":%s}\n", name, line);
+  fflush(stdout);
+  return 0;
+}
+
+int main(const int argc, char * const argv[]){
+  unsigned int i;
+
+  snprintf(perror_buf, sizeof(perror_buf), "%s: Error: ", argv[0]);
+
+  /* queue code logs at debug level, keep it out of the way */
+  if(log_open("/dev/null", 0, LOG_ALWAYS) < 0){
+    return EXIT_FAILURE;
+  }
+
+  for(i=0; i < SIZE_COUNT; i++){
+    if( (bench_bv(sizes[i]) < 0) ||
+        (bench_rq(sizes[i], RQ_FIFO, "fifo") < 0) ||
+        (bench_rq(sizes[i], RQ_CFS,  "cfs") < 0) ||
+        (bench_rq(sizes[i], RQ_MLFQ, "mlfq") < 0) ||
+        (bench_bq(sizes[i]) < 0) ||
+        (bench_find(sizes[i]) < 0)){
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* end to end, at several process table sizes */
+  char * des_small[]  = {"-D", "-p", "18",   "-t", "100000", NULL};
+  char * des_large[]  = {"-D", "-p", "1000", "-t", "100000", "-c", "16", NULL};
+  char * thr_small[]  = {"-T", "-p", "18",   "-t", "2000", NULL};
+  char * thr_ring[]   = {"-T", "-f", "-p", "18", "-t", "2000", NULL};
+  char * thr_large[]  = {"-T", "-f", "-p", "256", "-t", "5000", "-c", "8", NULL};
+  char * proc_small[] = {"-p", "18",  "-t", "500", NULL};
+  char * proc_ring[]  = {"-f", "-p", "18", "-t", "500", "-c", "4", "-P", "8", NULL};
+
+  if( (bench_oss("des_p18", des_small) < 0) ||
+      (bench_oss("des_p1000_c16", des_large) < 0) ||
+      (bench_oss("thread_p18", thr_small) < 0) ||
+      (bench_oss("thread_ring_p18", thr_ring) < 0) ||
+      (bench_oss("thread_ring_p256_c8", thr_large) < 0) ||
+      (bench_oss("proc_p18", proc_small) < 0) ||
+      (bench_oss("proc_ring_p18_c4_P8", proc_ring) < 0)){
+    return EXIT_FAILURE;
+  }
+
+  log_close();
+  return EXIT_SUCCESS;
+}
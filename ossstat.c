@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/shm.h>
+
+#include "common.h"
+#include "stats.h"
+
+/* Print rates of a running oss once per interval, like vmstat.
+   Attaches read only to the live stats segment of oss */
+
+/* header is printed again after that many lines */
+#define HEADER_EVERY 20
+
+static void print_header(){
+  printf("%8s %12s %8s %8s %10s %8s %4s %7s %6s  %s\n",
+    "wall_s", "sim_s", "started", "exited", "disp/s", "exit/s", "run", "blocked", "idle%", "RQ lengths");
+}
+
+/* one line with rates between two snapshots */
+static void print_rates(const struct oss_stats * a, const struct oss_stats * b, const uint64_t start_ns){
+  unsigned int i;
+
+  const double dt = (b->wall_ns > a->wall_ns) ? (b->wall_ns - a->wall_ns) / 1e9 : 0.0;
+  const uint64_t dsim = b->clock - a->clock;
+
+  printf("%8.1f %5lu.%06lu %8lu %8lu %10.0f %8.0f %4u %7u %6.1f ",
+    (b->wall_ns - start_ns) / 1e9,
+    (unsigned long) (b->clock / NS_PER_SEC), (unsigned long) ((b->clock % NS_PER_SEC) / NS_PER_USEC),
+    (unsigned long) b->started, (unsigned long) b->exited,
+    (dt > 0) ? (b->dispatches - a->dispatches) / dt : 0.0,
+    (dt > 0) ? (b->exited - a->exited) / dt : 0.0,
+    b->running, b->blocked,
+    (dsim > 0) ? 100.0 * (b->idle - a->idle) / dsim : 0.0);
+
+  for(i=0; i < b->rq_count; i++){
+    printf(" %u", b->rq_len[i]);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+int main(const int argc, char * const argv[]){
+  struct oss_stats prev, cur;
+  unsigned int interval = 1, count = 0, lines = 0, instance = 0;
+  int opt;
+
+  snprintf(perror_buf, sizeof(perror_buf), "%s: Error: ", argv[0]);
+
+  while((opt = getopt(argc, argv, "hd:n:i:")) != -1){
+    switch(opt){
+      case 'd':
+        interval = atoi(optarg);
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'i':
+        /* same instance as oss -i, 0 is the default run */
+        if(opt_number(optarg, "simulator instance", &instance) < 0){
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'h':
+      default:
+        fprintf(stderr, "Usage: ./ossstat [-h] [-d seconds] [-n count] [-i instance]\n");
+        fprintf(stderr, "\t-d Seconds between lines (1)\n");
+        fprintf(stderr, "\t-n Lines to print, 0 until oss exits (0)\n");
+        fprintf(stderr, "\t-i Simulator instance of oss -i, above 0 (0)\n");
+        return EXIT_FAILURE;
+    }
+  }
+  if(interval == 0){
+    interval = 1;
+  }
+
+  simulator_instance(instance);
+  const struct oss_stats * stats = stats_attach();
+  if(stats == NULL){
+    fprintf(stderr, "ossstat: Is oss running?\n");
+    return EXIT_FAILURE;
+  }
+
+  if(stats_read(stats, &prev) < 0){
+    fprintf(stderr, "ossstat: Stats version doesn't match, expected %d\n", STATS_VERSION);
+    return EXIT_FAILURE;
+  }
+  const uint64_t start_ns = prev.wall_ns;
+
+  while(!prev.done && ((count == 0) || (lines < count))){
+    sleep(interval);
+
+    if((stats_read(stats, &cur) < 0) ||
+       ((kill(cur.pid, 0) == -1) && (errno == ESRCH))){
+      break;  /* oss is gone */
+    }
+
+    if((lines % HEADER_EVERY) == 0){
+      print_header();
+    }
+    print_rates(&prev, &cur, start_ns);
+    lines++;
+    prev = cur;
+  }
+
+  shmdt(stats);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+/* Convert binary oss trace to Chrome trace event JSON (chrome://tracing, Perfetto).
+   Each process is a thread of pid 1, and each simulated CPU a thread of pid 0 */
+enum track_group {G_CPU=0, G_PROC};
+
+/* open spans of a control block */
+struct slot_state {
+  uint64_t ready_from, blocked_from;
+  int ready, blocked;
+  int core;   /* CPU of last dispatch */
+};
+
+static FILE * out = NULL;
+static int first = 1;
+
+/* print event separator and common fields */
+static void event_begin(const char * name, const char * ph, const enum track_group g, const int tid, const uint64_t ts){
+  fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+    (first) ? "" : ",", name, ph, g, tid, ts / 1000.0);
+  first = 0;
+}
+
+static void event_span(const char * name, const enum track_group g, const int tid, const uint64_t ts, const uint64_t dur){
+  event_begin(name, "X", g, tid, ts);
+  fprintf(out, ",\"dur\":%.3f}", dur / 1000.0);
+}
+
+static void event_instant(const char * name, const int tid, const uint64_t ts){
+  event_begin(name, "i", G_PROC, tid, ts);
+  fprintf(out, ",\"s\":\"t\"}");
+}
+
+static void track_name(const char * what, const enum track_group g, const int tid, const char * name){
+  fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+    (first) ? "" : ",", what, g, tid, name);
+  first = 0;
+}
+
+int main(const int argc, char * const argv[]){
+  struct stat st;
+  char name[32];
+  uint64_t i;
+  uint32_t c;
+
+  if((argc < 2) || (argc > 3)){
+    fprintf(stderr, "Usage: ./osstrace trace.bin [trace.json]\n");
+    return EXIT_FAILURE;
+  }
+
+  const int fd = open(argv[1], O_RDONLY);
+  if((fd == -1) || (fstat(fd, &st) == -1)){
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  if(st.st_size < (off_t) sizeof(struct trace_header)){
+    fprintf(stderr, "%s: Not a trace file\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  const struct trace_header * hdr = (struct trace_header*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(hdr == MAP_FAILED){
+    perror("mmap");
+    return EXIT_FAILURE;
+  }
+  madvise((void*) hdr, st.st_size, MADV_SEQUENTIAL);
+
+  if( (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) != 0) ||
+      (hdr->version != TRACE_VERSION) ||
+      (hdr->record_size != sizeof(struct trace_record))){
+    fprintf(stderr, "%s: Unsupported trace file\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  /* don't trust count beyond file size */
+  uint64_t count = (st.st_size - sizeof(struct trace_header)) / sizeof(struct trace_record);
+  if(hdr->count < count){
+    count = hdr->count;
+  }
+
+  struct slot_state * slots = (struct slot_state*) calloc(hdr->proc_limit, sizeof(struct slot_state));
+  if(slots == NULL){
+    perror("calloc");
+    return EXIT_FAILURE;
+  }
+
+  out = (argc == 3) ? fopen(argv[2], "w") : stdout;
+  if(out == NULL){
+    perror(argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  const uint32_t cores = (hdr->cores == 0) ? 1 : hdr->cores;
+  track_name("process_name", G_CPU, 0, "CPUs");
+  track_name("process_name", G_PROC, 0, "Processes");
+  for(c=0; c < cores; c++){
+    snprintf(name, sizeof(name), "CPU %u", c);
+    track_name("thread_name", G_CPU, c, name);
+  }
+
+  const struct trace_record * r = (const struct trace_record*) &hdr[1];
+  for(i=0; i < count; i++, r++){
+
+    struct slot_state * slot = NULL;
+    if((r->id >= 0) && ((uint32_t) r->id < hdr->proc_limit)){
+      slot = &slots[r->id];
+    }else if(r->event != TR_IDLE){
+      continue; /* corrupt record */
+    }
+
+    switch(r->event){
+      case TR_FORK:
+        bzero(slot, sizeof(struct slot_state));
+        snprintf(name, sizeof(name), "P%d", r->pid);
+        track_name("thread_name", G_PROC, r->pid, name);
+        event_instant("fork", r->pid, r->time);
+        break;
+
+      case TR_ENQUEUE:
+        slot->ready = 1;
+        slot->ready_from = r->time;
+        break;
+
+      case TR_DISPATCH:
+        if(slot->ready){
+          event_span("ready", G_PROC, r->pid, slot->ready_from, r->time - slot->ready_from);
+          slot->ready = 0;
+        }
+        slot->core = (r->arg < cores) ? r->arg : 0;
+        break;
+
+      case TR_BURST:
+        event_span("run", G_PROC, r->pid, r->time, r->arg);
+        snprintf(name, sizeof(name), "P%d", r->pid);
+        event_span(name, G_CPU, slot->core, r->time, r->arg);
+        break;
+
+      case TR_BLOCK:
+        slot->blocked = 1;
+        slot->blocked_from = r->time;
+        break;
+
+      case TR_UNBLOCK:
+        if(slot->blocked){
+          event_span("blocked", G_PROC, r->pid, slot->blocked_from, r->time - slot->blocked_from);
+          slot->blocked = 0;
+        }
+        break;
+
+      case TR_EXIT:
+        event_instant("exit", r->pid, r->time);
+        break;
+
+      case TR_IDLE:
+        /* all CPUs were idle */
+        for(c=0; c < cores; c++){
+          event_span("idle", G_CPU, c, r->time, r->arg);
+        }
+        break;
+    }
+  }
+
+  fprintf(out, "\n]}\n");
+  if(hdr->dropped){
+    fprintf(stderr, "osstrace: trace is missing %lu dropped records\n", (unsigned long) hdr->dropped);
+  }
+
+  if(out != stdout){
+    fclose(out);
+  }
+  free(slots);
+  munmap((void*) hdr, st.st_size);
+  close(fd);
+
+  return EXIT_SUCCESS;
+}
@@ -1,185 +1,437 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <strings.h>
 #include "common.h"
 #include "queue.h"
+#include "log.h"
+#include "trace.h"
+#include "cfs.h"
 
 /* read queues - high and low */
-static struct queue RQ[RQ_COUNT];
+static struct rqueue * RQ = NULL;
+static unsigned int rq_count = 0;
+/* bit is set for each ready queue with items */
+static uint64_t rq_bitmap = 0;
+static int rq_total = 0;  /* processes in all ready queues */
 /* blocked queue */
 static struct queue BQ;
 
-void queues_init(){
-  bzero(RQ, sizeof(RQ));
+int queues_init(){
+  unsigned int i;
+
+  rq_count = simulator_obj->cfg.rq_count;
+  rq_total = 0;
+  RQ = (struct rqueue*) malloc(sizeof(struct rqueue) * rq_count);
+  if(RQ == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  for(i=0; i < rq_count; i++){
+    RQ[i].head = RQ[i].tail = -1;
+    RQ[i].len = 0;
+  }
+  rq_bitmap = 0;
+
+  cfs_init();
+
   bzero(&BQ, sizeof(BQ));
+  BQ.size = simulator_obj->cfg.proc_limit;
+  BQ.items = (struct qitem*) malloc(sizeof(struct qitem) * BQ.size);
+  if(BQ.items == NULL){
+    perror(perror_buf);
+    return -1;
+  }
+
+  return 0;
 }
 
-/* Add a process PID to ready queue */
-int rq_push(const pid_t pid){
+int queues_save(FILE * fp){
+  if( (fwrite(RQ, sizeof(struct rqueue), rq_count, fp) != rq_count) ||
+      (fwrite(&rq_bitmap, sizeof(rq_bitmap), 1, fp) != 1) ||
+      (fwrite(&rq_total, sizeof(rq_total), 1, fp) != 1) ||
+      (fwrite(&BQ.len, sizeof(BQ.len), 1, fp) != 1) ||
+      (fwrite(BQ.items, sizeof(struct qitem), BQ.len, fp) != (size_t) BQ.len)){
+    return -1;
+  }
+  return cfs_save(fp);
+}
 
-  struct proc * proc = find_proc(pid);
+int queues_load(FILE * fp){
+  if( (fread(RQ, sizeof(struct rqueue), rq_count, fp) != rq_count) ||
+      (fread(&rq_bitmap, sizeof(rq_bitmap), 1, fp) != 1) ||
+      (fread(&rq_total, sizeof(rq_total), 1, fp) != 1) ||
+      (fread(&BQ.len, sizeof(BQ.len), 1, fp) != 1) ||
+      (BQ.len < 0) || (BQ.len > BQ.size) ||
+      (fread(BQ.items, sizeof(struct qitem), BQ.len, fp) != (size_t) BQ.len)){
+    return -1;
+  }
+  return cfs_load(fp);
+}
 
-  /* Use type of process (CPU/IO bound) to determine which queue to use */
-  struct queue * q = &RQ[proc->bound];
+void queues_deinit(){
+  free(RQ);
+  free(BQ.items);
+  RQ = NULL;
+  BQ.items = NULL;
+}
 
-  if(q->len < PROC_LIMIT){
-    printf("OSS: Process %d queued into RQ %d\n", proc->pid, proc->bound);
+/* Mark a new control block as not queued */
+void queues_proc_init(struct proc * proc){
+  proc->rq_level = -1;
+  proc->rq_prev = proc->rq_next = proc->rq_child = -1;
+  proc->rq_prio = 0;
+  proc->bq_pos = -1;
+}
 
-    q->items[q->len].pid   = proc->pid;
-    /* here age and insert time are the same */
-    q->items[q->len].tv    =
-    q->items[q->len].added = simulator_obj->clock;
+/* Add a process to ready queue */
+int rq_push(const int id){
 
-    q->len++;
+  struct proc * proc = &simulator_obj->procs[id];
+
+  if(proc->rq_level != -1){
+    fprintf(stderr, "ERROR: Process %d is already in ready queue\n", proc->pid);
+    return -1;
+  }
+  proc->rq_added = simulator_obj->clock;
+  rq_total++;
 
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    cfs_push(proc);
+    log_msg(LOG_DEBUG, "OSS: Process %d queued with vruntime %lu\n", proc->pid, (unsigned long) proc->vruntime);
+    trace_add(TR_ENQUEUE, id, simulator_obj->clock, 0);
     return 0;
+  }
+
+  /* Use type of process (CPU/IO bound) or its feedback priority to determine which queue to use */
+  const unsigned int prio = (simulator_obj->cfg.engine == RQ_MLFQ) ? proc->rq_prio : proc->bound;
+  const int level = (prio < rq_count) ? prio : rq_count - 1;
+  struct rqueue * q = &RQ[level];
+
+  log_msg(LOG_DEBUG, "OSS: Process %d queued into RQ %d\n", proc->pid, level);
+  trace_add(TR_ENQUEUE, id, simulator_obj->clock, level);
+
+  /* link at tail of the queue */
+  proc->rq_level = level;
+  proc->rq_prev  = q->tail;
+  proc->rq_next  = -1;
+
+  if(q->tail == -1){
+    q->head = proc->id;
   }else{
-    fprintf(stderr, "ERROR: Ready queue is full\n");
-    return -1;
+    simulator_obj->procs[q->tail].rq_next = proc->id;
   }
+  q->tail = proc->id;
+  q->len++;
+  rq_bitmap |= (1ULL << level);
+
+  return 0;
 }
 
-/* Find first queue with items */
-static struct queue * next_rq(){
-  int i;
-  for(i=0; i < RQ_COUNT; i++){
-    if(RQ[i].len != 0){
-      return &RQ[i];
-    }
+/* Unlink a process from its ready queue */
+static void rq_remove(struct proc * proc){
+  rq_total--;
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    cfs_remove(proc);
+    return;
   }
-  return NULL;
-}
 
-/* Find process that waited most */
-static int rq_waited_most(struct queue * q){
-  int i, max = 0;
-  for(i=1; i < q->len; i++){
-    if(timercmp(&q->items[max].tv, &q->items[i].tv, >)){
-      max = i;
-    }
+  struct rqueue * q = &RQ[proc->rq_level];
+
+  if(proc->rq_prev == -1){
+    q->head = proc->rq_next;
+  }else{
+    simulator_obj->procs[proc->rq_prev].rq_next = proc->rq_next;
   }
-  return max;
-}
 
-static void rq_shift(struct queue * q, const int pos){
-  int i;
-  for(i=pos + 1; i < q->len; i++){
-    q->items[i-1] = q->items[i];
+  if(proc->rq_next == -1){
+    q->tail = proc->rq_prev;
+  }else{
+    simulator_obj->procs[proc->rq_next].rq_prev = proc->rq_prev;
   }
   q->len--;
+  if(q->len == 0){
+    rq_bitmap &= ~(1ULL << proc->rq_level);
+  }
+
+  proc->rq_level = -1;
+  proc->rq_prev = proc->rq_next = -1;
+}
+
+/* Find first queue with items, at level from or lower */
+static int next_rq(const unsigned int from){
+  const uint64_t bits = (from < 64) ? (rq_bitmap & (~0ULL << from)) : 0;
+  return (bits == 0) ? -1 : __builtin_ctzll(bits);
 }
 
 /* Remove a process from ready queue */
-pid_t rq_pop(void){
+int rq_pop(void){
+
+  int id, level = 0;
 
-  struct timeval wt;
-  struct queue * q = next_rq();
-  struct proc * proc = NULL;
-  int waited_most = 0;
-  pid_t pid = 0;
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    /* process that ran least */
+    id = cfs_top();
+  }else{
+    /* head of the queue is the process that waited most */
+    level = next_rq(0);
+    id = (level == -1) ? -1 : RQ[level].head;
+  }
 
-  if(q == NULL){
+  if(id == -1){
     /* if all queues are empty */
-    return 0;
+    return -1;
+  }
+
+  struct proc * proc = &simulator_obj->procs[id];
+  rq_remove(proc);
+
+  /* update its wait time */
+  proc->timer[T_WAIT] += simulator_obj->clock - proc->rq_added;
+
+  log_msg(LOG_DEBUG, "OSS: Pop PID %d from ready queue %i at time " TIME_FMT ",\n",
+    proc->pid, level, TIME_ARG(simulator_obj->clock));
+
+  return proc->id;
+}
+
+/* Ready process after id in dispatch order, or the first one if id is -1.
+   Returns -1 at the end. Fair queue has no order after the first */
+int rq_walk(const int id){
+  unsigned int from = 0;
+
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    return (id == -1) ? cfs_top() : -1;
   }
 
-  /* Find process that waited most in this queue */
-  while((proc == NULL) && (q->len > 0)){
-    waited_most = rq_waited_most(q);
-    if(waited_most == -1){
-      return 0;
+  if(id != -1){
+    const struct proc * proc = &simulator_obj->procs[id];
+    if(proc->rq_next != -1){
+      return proc->rq_next;
     }
-    pid = q->items[waited_most].pid;
+    from = proc->rq_level + 1;
+  }
+
+  const int level = next_rq(from);
+  return (level == -1) ? -1 : RQ[level].head;
+}
+
+/* Slice for a process that is dispatched */
+simtime_t rq_slice(const int id){
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    return cfs_slice(&simulator_obj->procs[id]);
+
+  }else if(simulator_obj->cfg.engine == RQ_MLFQ){
+    /* quantum doubles with each lower level, down to MLFQ_MAX_DOUBLING */
+    const unsigned int prio = simulator_obj->procs[id].rq_prio;
+    return (simtime_t) simulator_obj->cfg.slice_ns << ((prio < MLFQ_MAX_DOUBLING) ? prio : MLFQ_MAX_DOUBLING);
+  }
+  return simulator_obj->cfg.slice_ns;
+}
 
-    proc = find_proc(pid);
-    if(proc == NULL){ /* if not found, proc terminated*/
-      rq_shift(q, waited_most);
+/* Update process priority, after its burst */
+void rq_account(const int id, const simtime_t burst, const enum proc_action action){
+  struct proc * proc = &simulator_obj->procs[id];
+
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    cfs_account(proc, burst);
+
+  }else if(simulator_obj->cfg.engine == RQ_MLFQ){
+    if((action == ACT_EXEC) && (proc->rq_prio < (rq_count - 1))){
+      /* used its whole quantum */
+      proc->rq_prio++;
+      log_msg(LOG_DEBUG, "OSS: Process %d demoted to level %u\n", proc->pid, proc->rq_prio);
+    }else if((action == ACT_INT) && (proc->rq_prio > 0)){
+      /* blocked before quantum was over */
+      proc->rq_prio--;
+      log_msg(LOG_DEBUG, "OSS: Process %d promoted to level %u\n", proc->pid, proc->rq_prio);
     }
   }
+}
 
-  if(proc == NULL){
-    return 0;
+int rq_size(void){
+  return rq_total;
+}
+
+int rq_length(const unsigned int level){
+  if(simulator_obj->cfg.engine == RQ_CFS){
+    /* one heap, reported as first level */
+    return (level == 0) ? cfs_length() : 0;
   }
+  return (level < rq_count) ? RQ[level].len : 0;
+}
 
-  /* update its wait time */
-  timersub(&simulator_obj->clock, &q->items[waited_most].added, &wt);
-  tincrement(&proc->timer[T_WAIT], &wt);
+/* Move all processes to top level, so low levels don't starve */
+void rq_boost(void){
+  unsigned int i;
+  struct rqueue * top = &RQ[0];
 
-  /* shift queue left */
-  rq_shift(q, waited_most);
+  for(i=0; i < simulator_obj->cfg.proc_limit; i++){
+    simulator_obj->procs[i].rq_prio = 0;
+  }
 
-  printf("OSS: Pop PID %d from ready queue %i at time %li:%li,\n",
-    pid, waited_most, simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
+  /* append lower queues to top one, in level order */
+  for(i=1; i < rq_count; i++){
+    struct rqueue * q = &RQ[i];
+    if(q->len == 0){
+      continue;
+    }
+
+    int id;
+    for(id = q->head; id != -1; id = simulator_obj->procs[id].rq_next){
+      simulator_obj->procs[id].rq_level = 0;
+    }
 
-  return pid;
+    if(top->tail == -1){
+      top->head = q->head;
+    }else{
+      simulator_obj->procs[top->tail].rq_next = q->head;
+      simulator_obj->procs[q->head].rq_prev = top->tail;
+    }
+    top->tail = q->tail;
+    top->len += q->len;
+
+    q->head = q->tail = -1;
+    q->len = 0;
+  }
+
+  if(top->len > 0){
+    rq_bitmap = 1;
+  }
+  log_msg(LOG_DEBUG, "OSS: Boosted all processes to level 0 at time " TIME_FMT "\n", TIME_ARG(simulator_obj->clock));
 }
 
-/* Add process to blocked queue, until time tv*/
-int bq_push(const pid_t pid, const struct timeval until){
-  if(BQ.len >= PROC_LIMIT){
-    printf("OSS: Blocked queue full!\n");
-    return -1;
+/* Blocked queue is a binary min-heap, ordered by the event time */
+static int bq_less(const struct qitem * a, const struct qitem * b){
+  if(a->tv == b->tv){
+    /* same event time, the one blocked first goes first */
+    return a->added < b->added;
   }
+  return a->tv < b->tv;
+}
 
-  struct qitem * item = &BQ.items[BQ.len];
-  item->pid = pid;
-  item->tv = until;
-  item->added = simulator_obj->clock;  //save insertion time
-  BQ.len++;
-  return 0;
+/* put item at position i, and save the position in its control block */
+static void bq_set(const int i, const struct qitem * item){
+  BQ.items[i] = *item;
+  simulator_obj->procs[item->id].bq_pos = i;
 }
 
-//find a process, which event has come
-static int bq_next(){
-  int i;
-  for(i=0; i < BQ.len; i++){
-    if(timercmp(&simulator_obj->clock, &BQ.items[i].tv, >=)){
-      printf("OSS: Process with PID %d event(%li:%li) ready at time %li:%li\n", BQ.items[i].pid,
-        BQ.items[i].tv.tv_sec, BQ.items[i].tv.tv_usec,
-        simulator_obj->clock.tv_sec, simulator_obj->clock.tv_usec);
-      return i;
+static void bq_swap(const int a, const int b){
+  struct qitem temp = BQ.items[a];
+  bq_set(a, &BQ.items[b]);
+  bq_set(b, &temp);
+}
+
+/* move item at position i up, until its parent is earlier */
+static void bq_up(int i){
+  while(i > 0){
+    const int parent = (i - 1) / 2;
+    if(!bq_less(&BQ.items[i], &BQ.items[parent])){
+      break;
     }
+    bq_swap(i, parent);
+    i = parent;
   }
-  return -1;
 }
 
-pid_t bq_pop(void){
-  int i;
-  struct timeval wt;
-  pid_t pid;
-  struct proc * proc = NULL;
+/* move item at position i down, until its children are later */
+static void bq_down(int i){
+  while(1){
+    const int left = (2*i) + 1, right = left + 1;
+    int min = i;
 
-  while((proc == NULL) && (BQ.len > 0)){
-    i = bq_next();
-    if(i == -1){
-      /* nobody can be unblocked now */
-      return 0;
+    if((left < BQ.len) && bq_less(&BQ.items[left], &BQ.items[min])){
+      min = left;
     }
-    pid = BQ.items[i].pid;
-
-    proc = find_proc(pid);
-    if(proc == NULL){ /* if not found, proc terminated*/
-      rq_shift(&BQ, i);
+    if((right < BQ.len) && bq_less(&BQ.items[right], &BQ.items[min])){
+      min = right;
+    }
+    if(min == i){
+      break;
     }
+    bq_swap(i, min);
+    i = min;
   }
+}
 
-  if(proc == NULL){
-    return 0;
+/* remove the event at position i from blocked queue */
+static void bq_remove(const int i){
+  simulator_obj->procs[BQ.items[i].id].bq_pos = -1;
+
+  BQ.len--;
+  if(i < BQ.len){
+    bq_set(i, &BQ.items[BQ.len]);
+    /* last item can go either way from its new position */
+    bq_up(i);
+    bq_down(simulator_obj->procs[BQ.items[i].id].bq_pos);
+  }
+}
+
+/* Add process to blocked queue, until time tv*/
+int bq_push(const int id, const simtime_t until){
+  if(BQ.len >= BQ.size){
+    log_msg(LOG_ERROR, "OSS: Blocked queue full!\n");
+    return -1;
+  }
+
+  struct qitem item;
+
+  item.id = id;
+  item.tv = until;
+  item.added = simulator_obj->clock;  //save insertion time
+  bq_set(BQ.len, &item);
+  BQ.len++;
+
+  trace_add(TR_BLOCK, id, item.added, until - item.added);
+
+  bq_up(BQ.len - 1);
+  return 0;
+}
+
+int bq_pop(void){
+  struct qitem item;
+
+  if((BQ.len == 0) || (simulator_obj->clock < BQ.items[0].tv)){
+    /* nobody can be unblocked now */
+    return -1;
   }
+  item = BQ.items[0];
+  bq_remove(0);
+
+  struct proc * proc = &simulator_obj->procs[item.id];
+
+  log_msg(LOG_DEBUG, "OSS: Process with PID %d event(" TIME_FMT ") ready at time " TIME_FMT "\n", proc->pid,
+    TIME_ARG(item.tv), TIME_ARG(simulator_obj->clock));
 
   /* update its wait time */
-  timersub(&simulator_obj->clock, &BQ.items[i].added, &wt);
-  tincrement(&proc->timer[T_BLOCKED], &wt);
+  proc->timer[T_BLOCKED] += simulator_obj->clock - item.added;
+  trace_add(TR_UNBLOCK, item.id, simulator_obj->clock, 0);
 
-  /* shift queue len */
-  rq_shift(&BQ, i);
+  return item.id;
+}
 
-  return pid;
+/* Number of processes in blocked queue */
+int bq_length(void){
+  return BQ.len;
 }
 
-/* Return process at top of blocked queue */
+/* Return process with earliest event in blocked queue */
 const struct qitem* bq_top(void){
   if(BQ.len == 0){
     return NULL;
   }
   return &BQ.items[0];
 }
+
+/* Remove a process from all queues */
+void queue_flush(const int id){
+  struct proc * proc = &simulator_obj->procs[id];
+
+  if(proc->rq_level != -1){
+    rq_remove(proc);
+  }
+
+  if(proc->bq_pos != -1){
+    bq_remove(proc->bq_pos);
+  }
+}
@@ -1,28 +1,49 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
+#include <stdio.h>
 #include "common.h"
 
 struct qitem {
-  pid_t pid;            //process waiting for the event
-  struct timeval tv;    //event time
-  struct timeval added; //queue insertion time
+  int id;               //control block of process waiting for the event
+  simtime_t tv;    //event time
+  simtime_t added; //queue insertion time
 };
 
 struct queue {
-  struct qitem items[PROC_LIMIT];
-  int len;
+  struct qitem * items;
+  int len, size;
 };
 
-int rq_push(const pid_t pid);
-pid_t rq_pop(void);
-int bq_push(const pid_t pid, const struct timeval tv);
+/* ready queue is a list, linked through the control blocks */
+struct rqueue {
+  int head, tail; //control block indexes, -1 if empty
+  int len;
+};
 
-pid_t bq_pop(void);
+/* queues work with control block indexes, pop returns -1 if empty */
+int rq_push(const int id);
+int rq_pop(void);
+int rq_walk(const int id);
+simtime_t rq_slice(const int id);
+void rq_account(const int id, const simtime_t burst, const enum proc_action action);
+void rq_boost(void);
+int bq_push(const int id, const simtime_t tv);
+/* processes in ready queue level, in all levels, and in blocked queue */
+int rq_length(const unsigned int level);
+int rq_size(void);
+int bq_length(void);
+
+int bq_pop(void);
 const struct qitem* bq_top(void);
 
-void queue_flush(pid_t pid);
+void queue_flush(const int id);
 
-void queues_init();
+int queues_init();
+void queues_deinit();
+/* write and read queue state, for checkpoints. Links are in the control blocks */
+int queues_save(FILE * fp);
+int queues_load(FILE * fp);
+void queues_proc_init(struct proc * proc);
 
 #endif
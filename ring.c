@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "common.h"
+#include "ring.h"
+
+/* futex is shared between processes, so no FUTEX_PRIVATE_FLAG */
+static int futex_wait(uint32_t * addr, const uint32_t val){
+  return syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static int futex_wake(uint32_t * addr){
+  return syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+void ring_init(struct msg_ring * r){
+  r->head = r->tail = 0;
+  r->waiting = 0;
+}
+
+int ring_push(struct msg_ring * r, const struct msgbuf * buf){
+  const uint32_t head = r->head;
+
+  /* we never have more than one message in flight per ring, but be safe */
+  while((head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) >= RING_SIZE){
+    sched_yield();
+  }
+
+  r->msgs[head & (RING_SIZE - 1)] = *buf;
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+  /* pairs with the fence in ring_pop, so we can't miss a sleeper */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&r->waiting, __ATOMIC_RELAXED)){
+    futex_wake(&r->head);
+  }
+  return 0;
+}
+
+int ring_pop(struct msg_ring * r, struct msgbuf * buf, const unsigned int spin){
+  const uint32_t tail = r->tail;
+  unsigned int i;
+
+  for(i=0; i < spin; i++){
+    if(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != tail){
+      break;
+    }
+    cpu_relax();
+  }
+
+  if(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail){
+    __atomic_store_n(&r->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    /* sleep, while head is still at our tail */
+    while(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail){
+      if((futex_wait(&r->head, tail) == -1) && (errno != EAGAIN) && (errno != EINTR)){
+        perror(perror_buf);
+        __atomic_store_n(&r->waiting, 0, __ATOMIC_RELAXED);
+        return -1;
+      }
+    }
+    __atomic_store_n(&r->waiting, 0, __ATOMIC_RELAXED);
+  }
+
+  *buf = r->msgs[tail & (RING_SIZE - 1)];
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include "common.h"
+
+/* messages a ring can hold, must be power of 2 */
+#define RING_SIZE 4
+#define RING_ALIGN 64
+
+/* Single producer, single consumer message ring in shared memory */
+struct msg_ring {
+  /* next message to write, also the futex word consumer sleeps on */
+  uint32_t head __attribute__((aligned(RING_ALIGN)));
+  /* consumer is (about to be) sleeping on head */
+  uint32_t waiting;
+  /* next message to read */
+  uint32_t tail __attribute__((aligned(RING_ALIGN)));
+  struct msgbuf msgs[RING_SIZE];
+};
+
+/* Channel of a control block - commands (oss -> user) and replies (user -> oss) */
+struct msg_chan {
+  struct msg_ring cmd;
+  struct msg_ring reply;
+};
+
+void ring_init(struct msg_ring * r);
+
+/* add message to ring, wake the consumer if it sleeps */
+int ring_push(struct msg_ring * r, const struct msgbuf * buf);
+
+/* take message from ring, spin for a while and then sleep if its empty */
+int ring_pop(struct msg_ring * r, struct msgbuf * buf, const unsigned int spin);
+
+#endif
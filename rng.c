@@ -0,0 +1,51 @@
+#include "rng.h"
+
+static uint64_t splitmix64(uint64_t * x){
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static uint64_t rotl(const uint64_t x, const int k){
+  return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(struct rng * r, const uint64_t seed, const uint64_t stream, const unsigned int kind){
+  /* mix stream and kind into the seed, so each pair starts far apart */
+  uint64_t key = (stream << 8) | kind;
+  uint64_t x = seed ^ splitmix64(&key);
+  int i;
+
+  for(i=0; i < 4; i++){
+    r->s[i] = splitmix64(&x);
+  }
+}
+
+uint64_t rng_next(struct rng * r){
+  uint64_t * s = r->s;
+  const uint64_t result = rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+unsigned int rng_below(struct rng * r, const unsigned int n){
+  /* multiply and shift, instead of a division */
+  return (unsigned int) (((rng_next(r) >> 32) * (uint64_t) n) >> 32);
+}
+
+uint64_t rng_below64(struct rng * r, const uint64_t n){
+  /* same numbers as rng_below, when n fits it */
+  if(n <= UINT32_MAX){
+    return rng_below(r, n);
+  }
+  return (uint64_t) (((unsigned __int128) rng_next(r) * n) >> 64);
+}
@@ -0,0 +1,25 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* streams of oss */
+enum rng_oss_stream  {RNG_ARRIVAL=0, RNG_BOUND, RNG_ADVANCE, RNG_OSS_COUNT};
+/* streams of each process */
+enum rng_proc_stream {RNG_TERM=0, RNG_INT, RNG_IO, RNG_PROC_COUNT};
+
+/* xoshiro256** generator state */
+struct rng {
+  uint64_t s[4];
+};
+
+/* seed a generator for stream and kind, from the global seed */
+void rng_seed(struct rng * r, const uint64_t seed, const uint64_t stream, const unsigned int kind);
+
+uint64_t rng_next(struct rng * r);
+
+/* random number in [0, n) */
+unsigned int rng_below(struct rng * r, const unsigned int n);
+uint64_t rng_below64(struct rng * r, const uint64_t n);
+
+#endif
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "stats.h"
+
+static int stats_shmid = -1;
+
+/* key for stats segment, next to the simulator object */
+static key_t stats_key(){
+  const key_t key = ftok(simulator_path(), 6666);
+  if(key == -1){
+    perror(perror_buf);
+  }
+  return key;
+}
+
+struct oss_stats * stats_create(){
+
+  /* DES runs have no simulator file, so make sure its there */
+  const int fd = open(simulator_path(), O_CREAT | O_WRONLY, 0700);
+  if(fd == -1){
+    perror(perror_buf);
+    return NULL;
+  }
+  close(fd);
+
+  const key_t key = stats_key();
+  if((key == -1) || (shm_remove_stale(key) < 0)){
+    return NULL;
+  }
+
+  stats_shmid = shmget(key, sizeof(struct oss_stats), IPC_CREAT | IPC_EXCL | S_IRWXU);
+  if(stats_shmid == -1){
+    perror(perror_buf);
+    return NULL;
+  }
+
+  struct oss_stats * stats = (struct oss_stats *) shmat(stats_shmid, NULL, 0);
+  if(stats == (void*)-1){
+    perror(perror_buf);
+    return NULL;
+  }
+  bzero(stats, sizeof(struct oss_stats));
+  stats->pid = getpid();
+  __atomic_store_n(&stats->version, STATS_VERSION, __ATOMIC_RELEASE);
+  return stats;
+}
+
+int stats_destroy(struct oss_stats * stats){
+  int rv = 0;
+
+  /* tell readers we are gone, before segment is removed */
+  stats_write_begin(stats);
+  stats->done = 1;
+  stats_write_end(stats);
+
+  if(shmdt(stats) == -1){
+    perror(perror_buf);
+    rv = -1;
+  }
+  if(shmctl(stats_shmid, IPC_RMID, NULL) == -1){
+    perror(perror_buf);
+    rv = -1;
+  }
+  /* simulator may have removed the file already */
+  if((unlink(simulator_path()) == -1) && (errno != ENOENT)){
+    perror(perror_buf);
+    rv = -1;
+  }
+  return rv;
+}
+
+const struct oss_stats * stats_attach(){
+  const key_t key = stats_key();
+  if(key == -1){
+    return NULL;
+  }
+
+  stats_shmid = shmget(key, 0, 0);
+  if(stats_shmid == -1){
+    perror(perror_buf);
+    return NULL;
+  }
+
+  const struct oss_stats * stats = (const struct oss_stats *) shmat(stats_shmid, NULL, SHM_RDONLY);
+  if(stats == (void*)-1){
+    perror(perror_buf);
+    return NULL;
+  }
+  return stats;
+}
+
+void stats_write_begin(struct oss_stats * stats){
+  /* odd sequence is visible, before any field changes */
+  __atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void stats_write_end(struct oss_stats * stats){
+  __atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELEASE);
+}
+
+int stats_read(const struct oss_stats * stats, struct oss_stats * copy){
+  uint32_t seq;
+
+  if(__atomic_load_n(&stats->version, __ATOMIC_ACQUIRE) != STATS_VERSION){
+    return -1;
+  }
+
+  /* retry, until no write happened during the copy */
+  do{
+    while((seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE)) & 1){
+      sched_yield();
+    }
+    memcpy(copy, stats, sizeof(struct oss_stats));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  }while(__atomic_load_n(&stats->seq, __ATOMIC_RELAXED) != seq);
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "config.h"
+
+#define STATS_VERSION 1
+
+/* Live counters of a run, in their own shared memory segment.
+   oss writes them under a sequence lock, ossstat reads them */
+struct oss_stats {
+  uint32_t version;     /* STATS_VERSION, readers check it */
+  uint32_t seq;         /* odd while oss is writing */
+  pid_t pid;            /* of oss */
+  uint32_t done;        /* run is over, segment goes away */
+
+  uint32_t rq_count;    /* valid entries in rq_len */
+  uint32_t cores;
+  uint64_t wall_ns;     /* monotonic time of last update */
+  uint64_t clock;       /* simulated time, ns */
+  uint64_t started, exited;
+  uint64_t dispatches;
+  uint64_t idle;        /* simulated time all CPUs were idle, ns */
+  uint32_t blocked;     /* processes in blocked queue */
+  uint32_t running;     /* busy CPUs */
+  uint32_t rq_len[RQ_MAX];
+};
+
+/* create stats segment for oss, and remove it */
+struct oss_stats * stats_create();
+int stats_destroy(struct oss_stats * stats);
+
+/* attach read only to stats of a running oss */
+const struct oss_stats * stats_attach();
+
+/* writer side of the sequence lock */
+void stats_write_begin(struct oss_stats * stats);
+void stats_write_end(struct oss_stats * stats);
+
+/* consistent copy of stats, -1 if version doesn't match */
+int stats_read(const struct oss_stats * stats, struct oss_stats * copy);
+
+#endif
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+/* Run oss over a grid of parameters, several runs at same time, and
+   collect summary of each run (-j) into one CSV. Each running oss gets
+   its own simulator instance (-i), so they don't share IPC */
+
+/* values of one grid axis, as oss arguments */
+#define AXIS_MAX 32
+struct axis {
+  const char * opt;         /* oss option */
+  char * values[AXIS_MAX];  /* NULL value means oss default */
+  int count;
+};
+
+enum axis_name {AX_PROC=0, AX_SLICE, AX_INT, AX_SEED, AX_COUNT};
+static struct axis axes[AX_COUNT] = {{"-p", {NULL}, 1}, {"-q", {NULL}, 1},
+                                     {"-I", {NULL}, 1}, {"-S", {NULL}, 1}};
+
+/* a run in flight */
+struct job {
+  pid_t pid;
+  int run;
+};
+
+static char * const * extra_args = NULL;  /* passed to each oss */
+static unsigned int instance_base = 100;
+static volatile sig_atomic_t stop_signal = 0;
+
+/* stop starting runs, running ones are told to stop and collected */
+static void sig_stop(const int sig){
+  stop_signal = sig;
+}
+
+/* split a list, separated by sep, into axis values */
+static int axis_parse(struct axis * ax, char * list, const char * sep){
+  char * tok;
+  ax->count = 0;
+  for(tok = strtok(list, sep); tok; tok = strtok(NULL, sep)){
+    if(ax->count == AXIS_MAX){
+      fprintf(stderr, "sweep: Too many values for %s\n", ax->opt);
+      return -1;
+    }
+    ax->values[ax->count++] = tok;
+  }
+  return (ax->count > 0) ? 0 : -1;
+}
+
+static void json_path(char * buf, const size_t size, const int run){
+  snprintf(buf, size, "/tmp/sweep.%d.%d.json", getpid(), run);
+}
+
+/* start oss for grid point run */
+static pid_t run_start(const int run, const unsigned int instance){
+  char json[64], ibuf[16];
+  char * argv[64];
+  int argc = 0, i, r = run;
+
+  json_path(json, sizeof(json), run);
+  snprintf(ibuf, sizeof(ibuf), "%u", instance);
+
+  argv[argc++] = "./oss";
+  argv[argc++] = "-i";
+  argv[argc++] = ibuf;
+  argv[argc++] = "-l";
+  argv[argc++] = "/dev/null";
+  argv[argc++] = "-z";
+  argv[argc++] = "0";
+  argv[argc++] = "-v";
+  argv[argc++] = "4";
+  argv[argc++] = "-j";
+  argv[argc++] = json;
+
+  /* run index is a number in mixed radix of axis sizes */
+  for(i=0; i < AX_COUNT; i++){
+    const char * value = axes[i].values[r % axes[i].count];
+    r /= axes[i].count;
+    if(value){
+      argv[argc++] = (char *) axes[i].opt;
+      argv[argc++] = (char *) value;
+    }
+  }
+  for(i=0; extra_args[i] && (argc < 63); i++){
+    argv[argc++] = extra_args[i];
+  }
+  argv[argc] = NULL;
+
+  const pid_t pid = fork();
+  if(pid == -1){
+    perror("fork");
+  }else if(pid == 0){
+    execv(argv[0], argv);
+    perror(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  return pid;
+}
+
+/* Read summary of a finished run */
+static char * run_result(const int run){
+  char json[64], line[2048];
+
+  json_path(json, sizeof(json), run);
+  FILE * fp = fopen(json, "r");
+  if(fp == NULL){
+    return NULL;
+  }
+  char * rv = fgets(line, sizeof(line), fp);
+  fclose(fp);
+  unlink(json);
+
+  if(rv == NULL){
+    return NULL;
+  }
+  line[strcspn(line, "\n")] = '\0';
+  return strdup(line);
+}
+
+/* Print keys (header) or values of a flat JSON object as CSV fields */
+static void csv_fields(FILE * out, const char * json, const int keys){
+  const char * p = json;
+  int first = 1;
+
+  while((p = strchr(p, '"')) != NULL){
+    /* key */
+    const char * key = ++p;
+    p = strchr(p, '"');
+    if((p == NULL) || (p[1] != ':')){
+      break;
+    }
+    const int key_len = p - key;
+    p += 2;
+
+    /* value, string or number */
+    const char * value = p;
+    int value_len;
+    if(*p == '"'){
+      value++;
+      p = strchr(value, '"');
+      if(p == NULL){
+        break;
+      }
+      value_len = p - value;
+      p++;
+    }else{
+      value_len = strcspn(p, ",}");
+      p += value_len;
+    }
+
+    if(keys){
+      fprintf(out, "%s%.*s", (first) ? "" : ",", key_len, key);
+    }else{
+      fprintf(out, "%s%.*s", (first) ? "" : ",", value_len, value);
+    }
+    first = 0;
+  }
+  fprintf(out, "\n");
+}
+
+int main(const int argc, char * const argv[]){
+  const char * out_path = NULL;
+  long jobs_max = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt, i, status;
+
+  while((opt = getopt(argc, argv, "hj:o:i:p:q:I:S:")) != -1){
+    switch(opt){
+      case 'j': jobs_max = atoi(optarg); break;
+      case 'o': out_path = optarg;       break;
+      case 'i':
+        if(atoi(optarg) <= 0){
+          fprintf(stderr, "sweep: Instance must be above 0, like oss -i\n");
+          return EXIT_FAILURE;
+        }
+        instance_base = atoi(optarg);
+        break;
+      case 'p': if(axis_parse(&axes[AX_PROC],  optarg, ",") < 0) return EXIT_FAILURE; break;
+      case 'q': if(axis_parse(&axes[AX_SLICE], optarg, ",") < 0) return EXIT_FAILURE; break;
+      case 'I': if(axis_parse(&axes[AX_INT],   optarg, "/") < 0) return EXIT_FAILURE; break;
+      case 'S': if(axis_parse(&axes[AX_SEED],  optarg, ",") < 0) return EXIT_FAILURE; break;
+      case 'h':
+      default:
+        fprintf(stderr, "Usage: ./sweep [-h] [-j jobs] [-o out.csv] [-i instance] [-p limits] [-q slices] [-I cpu,io/cpu,io] [-S seeds] [-- oss options]\n");
+        fprintf(stderr, "\t-j Runs at same time (online CPUs)\n");
+        fprintf(stderr, "\t-o CSV file with a row per run (stdout)\n");
+        fprintf(stderr, "\t-i First simulator instance, runs use the next jobs ones (100)\n");
+        fprintf(stderr, "\t-p, -q, -S Comma separated values of oss option\n");
+        fprintf(stderr, "\t-I Slash separated interrupt chances of oss -I\n");
+        return EXIT_FAILURE;
+    }
+  }
+  extra_args = &argv[optind];
+  if(jobs_max < 1){
+    jobs_max = 1;
+  }
+
+  int runs = 1;
+  for(i=0; i < AX_COUNT; i++){
+    runs *= axes[i].count;
+  }
+
+  char ** results = (char **) calloc(runs, sizeof(char*));
+  struct job * jobs = (struct job *) calloc(jobs_max, sizeof(struct job));
+  if((results == NULL) || (jobs == NULL)){
+    perror("calloc");
+    return EXIT_FAILURE;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sig_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  int next = 0, running = 0, failed = 0, stopped = 0;
+  while((next < runs) || (running > 0)){
+
+    /* forward the stop once, a Ctrl-C has reached oss runs already */
+    if(stop_signal && !stopped){
+      for(i=0; i < jobs_max; i++){
+        if(jobs[i].pid > 0){
+          kill(jobs[i].pid, stop_signal);
+        }
+      }
+      fprintf(stderr, "sweep: Stopped, %d runs not started\n", runs - next);
+      next = runs;
+      stopped = 1;
+      if(running == 0){
+        break;
+      }
+    }
+
+    /* fill free job slots, slot selects the instance */
+    for(i=0; (i < jobs_max) && (next < runs); i++){
+      if(jobs[i].pid > 0){
+        continue;
+      }
+      jobs[i].run = next++;
+      jobs[i].pid = run_start(jobs[i].run, instance_base + i);
+      if(jobs[i].pid == -1){
+        return EXIT_FAILURE;
+      }
+      running++;
+    }
+
+    const pid_t pid = wait(&status);
+    if((pid == -1) && (errno == EINTR)){
+      continue;
+    }else if(pid == -1){
+      perror("wait");
+      return EXIT_FAILURE;
+    }
+    for(i=0; i < jobs_max; i++){
+      if(jobs[i].pid == pid){
+        break;
+      }
+    }
+    if(i == jobs_max){
+      continue;
+    }
+    jobs[i].pid = 0;
+    running--;
+
+    const int run = jobs[i].run;
+    results[run] = run_result(run);
+    if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0) || (results[run] == NULL)){
+      fprintf(stderr, "sweep: Run %d failed\n", run);
+      failed++;
+    }else{
+      fprintf(stderr, "sweep: Run %d of %d done\n", run + 1, runs);
+    }
+  }
+
+  FILE * out = stdout;
+  if(out_path && ((out = fopen(out_path, "w")) == NULL)){
+    perror(out_path);
+    return EXIT_FAILURE;
+  }
+
+  /* header from first result, all runs have same fields */
+  int header = 0;
+  for(i=0; i < runs; i++){
+    if(results[i] == NULL){
+      continue;
+    }
+    if(!header){
+      fprintf(out, "run,");
+      csv_fields(out, results[i], 1);
+      header = 1;
+    }
+    fprintf(out, "%d,", i);
+    csv_fields(out, results[i], 0);
+    free(results[i]);
+  }
+
+  if(out != stdout){
+    fclose(out);
+  }
+  free(results);
+  free(jobs);
+
+  return (failed || stopped) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
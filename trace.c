@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "config.h"
+#include "common.h"
+#include "trace.h"
+
+/* file is mapped once at its maximum size, it stays sparse until written */
+static struct trace_header * trace_map = NULL;
+static struct trace_record * trace_records = NULL;
+static uint64_t trace_max = 0;
+static int trace_fd = -1;
+
+int trace_open(const char * path, const unsigned int proc_limit, const unsigned int cores){
+
+  trace_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(trace_fd == -1){
+    perror(perror_buf);
+    return -1;
+  }
+
+  if(ftruncate(trace_fd, TRACE_MAX_SIZE) == -1){
+    perror(perror_buf);
+    return -1;
+  }
+
+  trace_map = (struct trace_header*) mmap(NULL, TRACE_MAX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, trace_fd, 0);
+  if(trace_map == MAP_FAILED){
+    perror(perror_buf);
+    trace_map = NULL;
+    return -1;
+  }
+
+  memcpy(trace_map->magic, TRACE_MAGIC, sizeof(trace_map->magic));
+  trace_map->version = TRACE_VERSION;
+  trace_map->record_size = sizeof(struct trace_record);
+  trace_map->proc_limit = proc_limit;
+  trace_map->cores = cores;
+
+  trace_records = (struct trace_record*) &trace_map[1];
+  trace_max = (TRACE_MAX_SIZE - sizeof(struct trace_header)) / sizeof(struct trace_record);
+  return 0;
+}
+
+void trace_add(const enum trace_event ev, const int id, const uint64_t t, const uint64_t arg){
+  if(trace_map == NULL){
+    return;
+  }
+
+  /* count is in the shared file osstrace reads, so update it atomically */
+  const uint64_t i = __atomic_fetch_add(&trace_map->count, 1, __ATOMIC_RELAXED);
+  if(i >= trace_max){
+    __atomic_fetch_sub(&trace_map->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&trace_map->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  struct trace_record * r = &trace_records[i];
+  r->time  = t;
+  r->arg   = arg;
+  r->id    = id;
+  r->pid   = (id >= 0) ? simulator_obj->procs[id].pid : 0;
+  r->event = ev;
+}
+
+void trace_close(){
+  if(trace_map == NULL){
+    return;
+  }
+
+  const off_t size = sizeof(struct trace_header) + (trace_map->count * sizeof(struct trace_record));
+  if(trace_map->dropped){
+    fprintf(stderr, "OSS: %lu trace records were dropped\n", (unsigned long) trace_map->dropped);
+  }
+
+  munmap(trace_map, TRACE_MAX_SIZE);
+  if(ftruncate(trace_fd, size) == -1){
+    perror(perror_buf);
+  }
+  close(trace_fd);
+
+  trace_map = NULL;
+  trace_fd = -1;
+}
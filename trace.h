@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "OSSTRACE"
+#define TRACE_VERSION 1
+
+/* scheduling events we record */
+enum trace_event {TR_FORK=0, TR_ENQUEUE, TR_DISPATCH, TR_BURST, TR_BLOCK,
+                  TR_UNBLOCK, TR_EXIT, TR_IDLE, TR_COUNT};
+
+/* trace file starts with this header, then records follow */
+struct trace_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t proc_limit;  /* control blocks, ids are below it */
+  uint32_t cores;       /* simulated CPUs, 0 means 1 */
+  uint64_t count;       /* records in file */
+  uint64_t dropped;     /* records that didn't fit */
+  uint64_t reserved[3];
+};
+
+struct trace_record {
+  uint64_t time;  /* simulated time in ns */
+  uint64_t arg;   /* queue level for enqueue, CPU for dispatch, ns for burst/block/idle */
+  int32_t pid;
+  int32_t id;     /* control block, -1 for oss */
+  uint8_t event;
+  uint8_t pad[7];
+};
+
+/* create trace file and map it */
+int trace_open(const char * path, const unsigned int proc_limit, const unsigned int cores);
+
+/* add a record at simulated time t (ns), if trace is open */
+void trace_add(const enum trace_event ev, const int id, const uint64_t t, const uint64_t arg);
+
+/* truncate file to the records written and unmap it */
+void trace_close();
+
+#endif
@@ -2,22 +2,22 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <ctype.h>
-#include <time.h>
 #include <strings.h>
 
 #include "config.h"
 #include "common.h"
+#include "burst.h"
+#include "workload.h"
 
 int main(const int argc, char * argv[]){
   int my_id;
-  struct msgbuf buf;
-  struct proc * proc;
 
   /* convert arguemnts to int */
   my_id  = atoi(argv[1]);
-
-  /* initialize the random generator */
-  srand(my_id + time(NULL));
+  /* instance of oss that started us */
+  if(argc > 2){
+    simulator_instance(strtoul(argv[2], NULL, 0));
+  }
 
   /* create the error string from program name */
   snprintf(perror_buf, sizeof(perror_buf), "%s: Error: ", argv[0]);
@@ -27,66 +27,26 @@ int main(const int argc, char * argv[]){
     return EXIT_FAILURE;
   }
 
-  /* get our control block */
-  proc = &simulator_obj->procs[my_id];
-  proc->action = ACT_EXEC;
-
-  while(proc->action != ACT_TERM){ //while we haven't decided to terminate
-
-    if(is_signalled){
-      break;
-    }
-
-    /* receive message from master */
-    buf.mtype = getpid();
-    if(msg_recv(&buf)  == -1){
-      break;
-    }
-
-    if(!timerisset(&buf.slice)){ //if time slice is 0
-      break;  //stop
-    }
-
-    /* terminate ?*/
-    if((rand() % 100) < CHANCE_TO_TERMINATE){
-
-      /* use part of allocated slice */
-      proc->timer[T_BURST].tv_usec = rand() % buf.slice.tv_usec;
-      proc->action = ACT_TERM;
-
-    }else{
-
-      /* interrupt for IO ?*/
-      if((rand() % 100) < interrupt_prob[proc->bound]){
-
-        proc->action = ACT_INT;
-
-        /* use part of allocated slice */
-        proc->timer[T_BURST].tv_usec = rand() % buf.slice.tv_usec;
-
-        /* IO duration */
-        proc->timer[T_IOEND].tv_sec  = rand() % 6;     //[0, 5]
-        proc->timer[T_IOEND].tv_usec = rand() % 1001;  //[0, 1000]
-
-      }else{
-        /* execute */
-        proc->action = ACT_EXEC;
-        /* process will execute for whole timeslice */
-        proc->timer[T_BURST] = buf.slice;
-      }
-    }
+  if((my_id < 0) || (my_id >= simulator_obj->cfg.proc_limit)){
+    fprintf(stderr, "%sInvalid control block %d\n", perror_buf, my_id);
+    destroy_simulator(0);
+    return EXIT_FAILURE;
+  }
 
-    bzero(&buf, sizeof(buf));
+  /* jobs are replayed from same file as oss */
+  if(simulator_obj->cfg.workload[0] && (workload_open(simulator_obj->cfg.workload) < 0)){
+    destroy_simulator(0);
+    return EXIT_FAILURE;
+  }
 
-    /* send message to oss, to inform our burst is over */
-    buf.mtype = TYPE_BURSTED;
-    /* save our ID in message */
-    buf.id = my_id;
-    if(msg_send(&buf) == -1){
-      break;
-    }
+  if(argc > 3){
+    /* pooled worker, runs many processes in its control block */
+    worker_loop(my_id, getpid());
+  }else{
+    burst_loop(my_id, getpid());
   }
 
+  workload_close();
   destroy_simulator(0);
 
   return EXIT_SUCCESS;
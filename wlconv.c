@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "workload.h"
+
+/* Convert a CSV workload to the binary file oss -w replays. Each line is
+   one job, in arrival order:
+
+     arrival,bound,cpu,io,cpu,io,...,cpu
+
+   Times are in nanoseconds, and bound is cpu or io (or 0 and 1). Job uses
+   the CPU, then blocks for IO, and terminates after its last CPU burst.
+   Empty lines and lines from # are skipped, so is a header line.
+   Lines are converted as they are read, so memory use is constant */
+
+/* parse a time field, returns -1 if it isn't a number, or is too big */
+static int field_time(const char * field, uint64_t * value){
+  char * end;
+
+  while(isspace((unsigned char) *field)){
+    field++;
+  }
+  if(!isdigit((unsigned char) *field)){
+    return -1;
+  }
+  errno = 0;
+  *value = strtoull(field, &end, 10);
+  if(errno == ERANGE){
+    return -1;
+  }
+  while(isspace((unsigned char) *end)){
+    end++;
+  }
+  return (*end == '\0') ? 0 : -1;
+}
+
+/* parse a bound field, the whole of it must be cpu, io, 0 or 1 */
+static int field_bound(const char * field, uint32_t * bound){
+  while(isspace((unsigned char) *field)){
+    field++;
+  }
+  size_t len = strlen(field);
+  while((len > 0) && isspace((unsigned char) field[len - 1])){
+    len--;
+  }
+
+  if(((len == 3) && (strncasecmp(field, "cpu", 3) == 0)) || ((len == 1) && (field[0] == '0'))){
+    *bound = 0;
+  }else if(((len == 2) && (strncasecmp(field, "io", 2) == 0)) || ((len == 1) && (field[0] == '1'))){
+    *bound = 1;
+  }else{
+    return -1;
+  }
+  return 0;
+}
+
+/* bursts of line being converted, grown as needed */
+static struct workload_burst * bursts = NULL;
+static size_t bursts_max = 0;
+
+/* Convert line to a job. Returns 1 if it was converted, 0 if skipped, -1 on error */
+static int line_parse(char * line, struct workload_job * job, const int first){
+  char * field;
+  uint64_t t;
+  int n = 0;
+
+  line[strcspn(line, "\r\n")] = '\0';
+  if((line[strspn(line, " \t")] == '\0') || (line[strspn(line, " \t")] == '#')){
+    return 0;
+  }
+
+  bzero(job, sizeof(struct workload_job));
+  for(field = strtok(line, ","); field; field = strtok(NULL, ","), n++){
+    if(n == 0){
+      if(field_time(field, &job->arrival) < 0){
+        /* header, if its not a number at all */
+        return (first && !isdigit((unsigned char) field[strspn(field, " \t")])) ? 0 : -1;
+      }
+    }else if(n == 1){
+      if(field_bound(field, &job->bound) < 0){
+        return -1;
+      }
+    }else{
+      if(field_time(field, &t) < 0){
+        return -1;
+      }
+
+      if(n % 2 == 0){ /* cpu of a new burst */
+        if(job->bursts == bursts_max){
+          bursts_max = (bursts_max) ? bursts_max * 2 : 64;
+          bursts = (struct workload_burst*) realloc(bursts, bursts_max * sizeof(struct workload_burst));
+          if(bursts == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+          }
+        }
+        bursts[job->bursts].cpu = t;
+        bursts[job->bursts].io = 0;
+        job->bursts++;
+      }else{
+        bursts[job->bursts - 1].io = t;
+      }
+    }
+  }
+
+  return (job->bursts > 0) ? 1 : -1;
+}
+
+int main(const int argc, char * const argv[]){
+  struct workload_header hdr;
+  struct workload_job job;
+  uint64_t last = 0;
+  unsigned long lineno = 0;
+  char * line = NULL;
+  size_t line_size = 0;
+
+  if(argc != 3){
+    fprintf(stderr, "Usage: ./wlconv workload.csv workload.bin\n");
+    fprintf(stderr, "\tLine of CSV is a job - arrival,bound,cpu,io,...,cpu, times in ns\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE * in = (strcmp(argv[1], "-") == 0) ? stdin : fopen(argv[1], "r");
+  if(in == NULL){
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  /* header is written again at end, with the counts */
+  FILE * out = fopen(argv[2], "w");
+  if(out == NULL){
+    perror(argv[2]);
+    return EXIT_FAILURE;
+  }
+  bzero(&hdr, sizeof(hdr));
+  memcpy(hdr.magic, WORKLOAD_MAGIC, sizeof(hdr.magic));
+  hdr.version = WORKLOAD_VERSION;
+  hdr.size = sizeof(hdr);
+  if(fwrite(&hdr, sizeof(hdr), 1, out) != 1){
+    perror(argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  while(getline(&line, &line_size, in) != -1){
+    lineno++;
+
+    const int rv = line_parse(line, &job, (hdr.jobs == 0));
+    if(rv == 0){
+      continue;
+    }else if(rv < 0){
+      fprintf(stderr, "%s:%lu: Invalid job\n", argv[1], lineno);
+      return EXIT_FAILURE;
+    }
+
+    if(job.arrival < last){
+      fprintf(stderr, "%s:%lu: Job arrives before previous one\n", argv[1], lineno);
+      return EXIT_FAILURE;
+    }
+    last = job.arrival;
+
+    if( (fwrite(&job, sizeof(job), 1, out) != 1) ||
+        (fwrite(bursts, sizeof(struct workload_burst), job.bursts, out) != job.bursts)){
+      perror(argv[2]);
+      return EXIT_FAILURE;
+    }
+    hdr.jobs++;
+    hdr.size += sizeof(job) + (job.bursts * sizeof(struct workload_burst));
+  }
+
+  if( (fseek(out, 0, SEEK_SET) == -1) ||
+      (fwrite(&hdr, sizeof(hdr), 1, out) != 1) ||
+      (fclose(out) == EOF)){
+    perror(argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  if(in != stdin){
+    fclose(in);
+  }
+  free(line);
+  free(bursts);
+
+  fprintf(stderr, "wlconv: %llu jobs written to %s\n", (unsigned long long) hdr.jobs, argv[2]);
+  return EXIT_SUCCESS;
+}
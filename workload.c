@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "common.h"
+#include "workload.h"
+
+/* file is mapped whole and read in place, so a workload of any size
+   opens at once, and pages are read as jobs get to them */
+static const struct workload_header * wl_map = NULL;
+static uint64_t wl_size = 0;
+static uint64_t wl_released = 0;  /* pages before it are dropped */
+
+int workload_open(const char * path){
+  struct stat st;
+
+  const int fd = open(path, O_RDONLY);
+  if((fd == -1) || (fstat(fd, &st) == -1)){
+    perror(perror_buf);
+    return -1;
+  }
+
+  if(st.st_size < (off_t) sizeof(struct workload_header)){
+    fprintf(stderr, "%s%s is not a workload file\n", perror_buf, path);
+    close(fd);
+    return -1;
+  }
+
+  wl_map = (struct workload_header*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(wl_map == MAP_FAILED){
+    perror(perror_buf);
+    wl_map = NULL;
+    return -1;
+  }
+  wl_size = st.st_size;
+  madvise((void*) wl_map, wl_size, MADV_SEQUENTIAL);
+
+  if( (memcmp(wl_map->magic, WORKLOAD_MAGIC, sizeof(wl_map->magic)) != 0) ||
+      (wl_map->version != WORKLOAD_VERSION)){
+    fprintf(stderr, "%s%s is not a workload of version %d\n", perror_buf, path, WORKLOAD_VERSION);
+    workload_close();
+    return -1;
+  }
+
+  if((wl_map->size != wl_size) || (wl_map->jobs == 0)){
+    fprintf(stderr, "%s%s is truncated or has no jobs\n", perror_buf, path);
+    workload_close();
+    return -1;
+  }
+
+  return 0;
+}
+
+void workload_close(){
+  if(wl_map == NULL){
+    return;
+  }
+  munmap((void*) wl_map, wl_size);
+  wl_map = NULL;
+  wl_size = 0;
+  wl_released = 0;
+}
+
+uint64_t workload_count(){
+  return (wl_map) ? wl_map->jobs : 0;
+}
+
+uint64_t workload_first(){
+  return sizeof(struct workload_header);
+}
+
+const struct workload_job * workload_job(const uint64_t off){
+  if((wl_map == NULL) || (off < sizeof(struct workload_header)) ||
+     (off + sizeof(struct workload_job) > wl_size)){
+    return NULL;
+  }
+
+  const struct workload_job * job = (const struct workload_job*) ((const char*) wl_map + off);
+  if((job->bursts == 0) ||
+     ((wl_size - off - sizeof(struct workload_job)) / sizeof(struct workload_burst) < job->bursts)){
+    return NULL;
+  }
+  return job;
+}
+
+uint64_t workload_next(const uint64_t off){
+  const struct workload_job * job = workload_job(off);
+  if(job == NULL){
+    return 0;
+  }
+
+  const uint64_t next = off + sizeof(struct workload_job) + (job->bursts * sizeof(struct workload_burst));
+  return (next < wl_size) ? next : 0;
+}
+
+const struct workload_burst * workload_burst(const uint64_t off){
+  return (const struct workload_burst*) ((const char*) wl_map + off);
+}
+
+void workload_release(const uint64_t off){
+  const uint64_t page = sysconf(_SC_PAGESIZE);
+  const uint64_t end = off & ~(page - 1);
+
+  if((wl_map == NULL) || (end < wl_released + WORKLOAD_RELEASE_SIZE)){
+    return;
+  }
+
+  /* file is only read, so a released page is read again if needed */
+  madvise((char*) wl_map + wl_released, end - wl_released, MADV_DONTNEED);
+  wl_released = end;
+}
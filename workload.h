@@ -0,0 +1,54 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+
+#define WORKLOAD_MAGIC "OSSWORK"
+#define WORKLOAD_VERSION 1
+
+/* Workload file starts with this header, then jobs follow in arrival
+   order. Each job record is followed by its bursts */
+struct workload_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t jobs;    /* job records in file */
+  uint64_t size;    /* file size, a shorter file is truncated */
+};
+
+struct workload_job {
+  uint64_t arrival; /* simulated time in ns */
+  uint32_t bound;   /* 0 for CPU, 1 for IO bound */
+  uint32_t bursts;  /* burst records after this one */
+};
+
+/* Job uses the CPU for cpu ns, then blocks for io ns. Last
+   burst of a job ends with its termination, its io is unused */
+struct workload_burst {
+  uint64_t cpu;
+  uint64_t io;
+};
+
+/* map workload file, and check its header */
+int workload_open(const char * path);
+void workload_close();
+
+/* jobs in workload, 0 if none is open */
+uint64_t workload_count();
+
+/* offset of first job */
+uint64_t workload_first();
+
+/* job at offset, NULL if its records are out of file */
+const struct workload_job * workload_job(const uint64_t off);
+
+/* offset of job after the one at off, 0 at end of file */
+uint64_t workload_next(const uint64_t off);
+
+/* burst at offset */
+const struct workload_burst * workload_burst(const uint64_t off);
+
+/* drop our mapped pages before offset, since jobs are read in order */
+void workload_release(const uint64_t off);
+
+#endif